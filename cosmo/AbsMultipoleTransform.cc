@@ -0,0 +1,9 @@
+// Created 18-Oct-2026
+
+#include "cosmo/AbsMultipoleTransform.h"
+
+namespace local = cosmo;
+
+local::AbsMultipoleTransform::AbsMultipoleTransform() { }
+
+local::AbsMultipoleTransform::~AbsMultipoleTransform() { }
@@ -0,0 +1,32 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_ABS_MULTIPOLE_TRANSFORM
+#define COSMO_ABS_MULTIPOLE_TRANSFORM
+
+#include <vector>
+
+namespace cosmo {
+	class AbsMultipoleTransform {
+	// Represents an engine for calculating 2D (Hankel) or 3D (spherical Bessel)
+	// multipole transforms of a real-valued function tabulated on a fixed grid.
+	public:
+		AbsMultipoleTransform();
+		virtual ~AbsMultipoleTransform();
+		// Returns the grid of u values where a function to be transformed should be
+		// evaluated when preparing the funcTable for calling the transform(...) method.
+		// The values in the u grid are always strictly decreasing (!) and positive.
+		virtual std::vector<double> const &getUGrid() const = 0;
+		// Returns the strictly increasing grid of v values where our transformed result
+		// will be estimated after calling the transform(...) method.
+		virtual std::vector<double> const &getVGrid() const = 0;
+		// Estimates the transform of func on our v grid using the the specified
+		// values of func(u) tabulated on our u grid. The results are saved in
+		// the results vector provided, which will be resized to our vgrid size
+		// if necessary.
+		virtual void transform(std::vector<double> const &funcTable,
+			std::vector<double> &result) const = 0;
+	private:
+	}; // AbsMultipoleTransform
+} // cosmo
+
+#endif // COSMO_ABS_MULTIPOLE_TRANSFORM
@@ -2,21 +2,23 @@
 
 #include "cosmo/AdaptiveMultipoleTransform.h"
 #include "cosmo/RuntimeError.h"
+#include "cosmo/NaturalSpline.h"
+#include "cosmo/Instrumentation.h"
 
-#include "likely/Interpolator.h"
-
-#include "boost/foreach.hpp"
+#include "boost/smart_ptr.hpp"
 
 #include <cmath>
 #include <algorithm>
+#include <limits>
 
 namespace local = cosmo;
 
 local::AdaptiveMultipoleTransform::AdaptiveMultipoleTransform(MultipoleTransform::Type type,
 int ell, double scale, std::vector<double>const &vpoints,
-double relerr, double abserr, double abspow)
-: _type(type), _ell(ell), _scale(scale), _vpoints(vpoints),
-_relerr(relerr), _abserr(abserr), _abspow(abspow), _veps(0)
+double relerr, double abserr, double abspow, MultipoleTransform::Precision precision)
+: _type(type), _precision(precision), _ell(ell), _scale(scale), _vpoints(vpoints),
+_relerr(relerr), _abserr(abserr), _abspow(abspow), _veps(0), _policy(AlwaysVerify),
+_period(1), _maxDrift(0), _sinceVerified(-1), _numVerifications(0), _lastAccurate(true)
 {
 	// Input parameter validation
 	if(_type != MultipoleTransform::SphericalBessel && _type != MultipoleTransform::Hankel) {
@@ -49,37 +51,77 @@ _relerr(relerr), _abserr(abserr), _abspow(abspow), _veps(0)
 
 local::AdaptiveMultipoleTransform::~AdaptiveMultipoleTransform() { }
 
-void local::AdaptiveMultipoleTransform::_evaluate(likely::GenericFunctionPtr f,
-MultipoleTransformCPtr transform,std::vector<double> &result) const {
+// The interpolation from a transform's v grid to our vpoints only depends on the grids,
+// so we calculate it once per transform.
+struct local::AdaptiveMultipoleTransform::EvaluationPlan {
+	EvaluationPlan(MultipoleTransformCPtr transform_, std::vector<double> const &vpoints)
+	: transform(transform_), resampler(transform_->getVGrid(),vpoints) { }
+	MultipoleTransformCPtr transform;
+	NaturalSplineResampler resampler;
+	// Log spacing of the transform's u grid, for a LogGridFunction.
+	double logu0, dlogu;
+	// Reusable workspaces
+	std::vector<double> fgrid, ftgrid, curv;
+};
+
+void local::AdaptiveMultipoleTransform::_evaluate(Source const &f,
+MultipoleTransformCPtr transform, EvaluationPlanPtr &plan, std::vector<double> &result) const {
 	// Look up this transforms grids
-	std::vector<double> const &ugrid = transform->getUGrid(), &vgrid = transform->getVGrid();
+	std::vector<double> const &ugrid = transform->getUGrid();
+	int nu(ugrid.size());
+	// (Re)build our plan the first time this transform is evaluated.
+	if(!plan || plan->transform != transform) {
+		plan.reset(new EvaluationPlan(transform,_vpoints));
+		plan->logu0 = std::log(ugrid.front());
+		plan->dlogu = std::log(ugrid.back()/ugrid.front())/(nu-1);
+		plan->fgrid.resize(nu);
+	}
 	// Prepare a grid of tabulated f(u) values
-	std::vector<double> fgrid;
-	fgrid.reserve(ugrid.size());
-	BOOST_FOREACH(double u, ugrid) {
-		fgrid.push_back((*f)(u));
+	std::vector<double> &fgrid = plan->fgrid, &ftgrid = plan->ftgrid;
+	{
+		COSMO_TIME(FunctionTime);
+		COSMO_COUNT(FunctionCalls,nu);
+		if(f.logGrid) {
+			(*f.logGrid)(plan->logu0,plan->dlogu,fgrid);
+		}
+		else {
+			for(int i = 0; i < nu; ++i) {
+				fgrid[i] = (*f.pointwise)(ugrid[i]);
+			}
+		}
 	}
 	// Calculate the corresponding grid of transform[f](v) values
-	std::vector<double> ftgrid;
 	(*transform).transform(fgrid,ftgrid);
-	// Interpolate transform[f](v) to _vpoints
-	likely::Interpolator interpolator(vgrid,ftgrid,"cspline");
-	int npoints(_vpoints.size());
-	if(result.size() != npoints) std::vector<double>(npoints).swap(result);
-	for(int i = 0; i < npoints; ++i) {
-		result[i] = _scale*interpolator(_vpoints[i]);
+	// Interpolate transform[f](v) to _vpoints, copying values directly for any points
+	// that coincide with the transform's native v grid.
+	COSMO_TIME(InterpolationTime);
+	if(!plan->resampler.isExact()) {
+		COSMO_COUNT(InterpolatorBuilds,1);
 	}
+	plan->resampler.resample(ftgrid,plan->curv,result,_scale);
 }
 
-bool local::AdaptiveMultipoleTransform::_isTerminated(double margin) const {
-	for(int i = 0; i < _vpoints.size(); ++i) {
-		double v(_vpoints[i]),f2e(_resultsGood[i]),fe(_resultsBetter[i]);
+double local::AdaptiveMultipoleTransform::getErrorRatio(std::vector<double> const &good,
+std::vector<double> const &better, double margin) const {
+	int npoints(_vpoints.size());
+	if(good.size() != npoints || better.size() != npoints) {
+		throw RuntimeError("AdaptiveMultipoleTransform::getErrorRatio: results have the wrong size.");
+	}
+	double ratio(0);
+	for(int i = 0; i < npoints; ++i) {
+		double v(_vpoints[i]),f2e(good[i]),fe(better[i]);
 		double df = std::fabs(fe - f2e);
-		if(df > _abserr*std::pow(v,_abspow)/margin && df > _relerr*std::fabs(fe)/margin) {
-			return false;
+		double tol = std::max(_abserr*std::pow(v,_abspow),_relerr*std::fabs(fe))/margin;
+		if(df > tol) {
+			if(tol <= 0) return std::numeric_limits<double>::infinity();
+			ratio = std::max(ratio,df/tol);
 		}
 	}
-	return true;
+	return ratio;
+}
+
+bool local::AdaptiveMultipoleTransform::_isTerminated(double margin) const {
+	return getErrorRatio(_resultsGood,_resultsBetter,margin) <= 1;
 }
 
 void local::AdaptiveMultipoleTransform::_saveResult(std::vector<double> &result) const {
@@ -95,6 +137,18 @@ void local::AdaptiveMultipoleTransform::_saveResult(std::vector<double> &result)
 
 double local::AdaptiveMultipoleTransform::initialize(
 likely::GenericFunctionPtr f, std::vector<double> &result,
+int minSamplesPerDecade, double margin, double vepsMax, double vepsMin, bool optimize) {
+	return _initialize(f,result,minSamplesPerDecade,margin,vepsMax,vepsMin,optimize);
+}
+
+double local::AdaptiveMultipoleTransform::initialize(
+LogGridFunctionPtr f, std::vector<double> &result,
+int minSamplesPerDecade, double margin, double vepsMax, double vepsMin, bool optimize) {
+	return _initialize(f,result,minSamplesPerDecade,margin,vepsMax,vepsMin,optimize);
+}
+
+double local::AdaptiveMultipoleTransform::_initialize(
+Source const &f, std::vector<double> &result,
 int minSamplesPerDecade, double margin, double vepsMax, double vepsMin, bool optimize) {
 	if(margin < 1) {
 		throw RuntimeError("AdaptiveMultipoleTransform: expected margin >= 1.");
@@ -116,62 +170,207 @@ int minSamplesPerDecade, double margin, double vepsMax, double vepsMin, bool opt
 			// would be for this trial veps
 			int noMinSamplesPerDecade(0);
 			_mtBetter.reset(new MultipoleTransform(_type, _ell, _vmin, _vmax, _veps,
-				strategy, minSamplesPerCycle, noMinSamplesPerDecade, interpolationPadding));
+				strategy, minSamplesPerCycle, noMinSamplesPerDecade, interpolationPadding,
+				MultipoleTransform::FastKernel, _precision));
 			// Is this veps small enough to meet our samples/decade requirement?
 			if(_mtBetter->getSamplesPerDecade() >= minSamplesPerDecade) break;
 			// Otherwise, try a smaller veps
 			_veps /= 2;
+			COSMO_COUNT(VepsHalvings,1);
 			if(_veps < vepsMin) {
 				throw RuntimeError("AdaptiveMultipoleTransform: reached vepsMin without convergence.");
 			}
 		}
 		// Calculate the corresponding prediction
-		_evaluate(f,_mtBetter,_resultsBetter);
+		_evaluate(f,_mtBetter,_planBetter,_resultsBetter);
 		// Initialize a "good" transformer with veps that is 2x larger
 		_mtGood.reset(new MultipoleTransform(_type, _ell, _vmin, _vmax, 2*_veps,
-			strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding));
-		_evaluate(f,_mtGood,_resultsGood);
+			strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding,
+			MultipoleTransform::FastKernel, _precision));
+		_evaluate(f,_mtGood,_planGood,_resultsGood);
 	}
+	double lastRatio(0), lastVeps(0);
+	int lastHalvings(0);
 	while(true) {
 		// Check our termination criteria
-		if(_isTerminated(margin)) {
+		double ratio = getErrorRatio(_resultsGood,_resultsBetter,margin);
+		if(ratio <= 1) {
+			// After a multi-step jump of n halvings from the last veps that failed, bisect
+			// on the number of halvings k = 1,...,n to find the largest veps that still meets
+			// the termination criteria. Testing k requires the transforms with k-1 and k
+			// halvings, and any transform already calculated is reused.
+			int lo(0), hi(lastHalvings);
+			if(hi > 1) {
+				std::vector<MultipoleTransformCPtr> mtProbe(hi+1);
+				std::vector<std::vector<double> > resultsProbe(hi+1);
+				mtProbe[hi-1] = _mtGood;
+				mtProbe[hi] = _mtBetter;
+				resultsProbe[hi-1].swap(_resultsGood);
+				resultsProbe[hi].swap(_resultsBetter);
+				EvaluationPlanPtr planProbe;
+				while(hi - lo > 1) {
+					int mid = (lo + hi)/2;
+					for(int k = mid-1; k <= mid; ++k) {
+						if(mtProbe[k]) continue;
+						mtProbe[k].reset(new MultipoleTransform(_type, _ell, _vmin, _vmax,
+							std::ldexp(lastVeps,-k), strategy, minSamplesPerCycle,
+							minSamplesPerDecade, interpolationPadding,
+							MultipoleTransform::FastKernel, _precision));
+						_evaluate(f,mtProbe[k],planProbe,resultsProbe[k]);
+					}
+					if(getErrorRatio(resultsProbe[mid-1],resultsProbe[mid],margin) <= 1) {
+						hi = mid;
+					}
+					else {
+						lo = mid;
+					}
+				}
+				// Our plans are rebuilt on their next use if the transforms have changed.
+				_veps = std::ldexp(lastVeps,-hi);
+				_mtGood = mtProbe[hi-1];
+				_mtBetter = mtProbe[hi];
+				_resultsGood.swap(resultsProbe[hi-1]);
+				_resultsBetter.swap(resultsProbe[hi]);
+			}
+			_sinceVerified = -1;
 			_saveResult(result);
 			if(optimize) {
 				// Recreate transform objects using the MeasurePlan strategy
 				strategy = MultipoleTransform::MeasurePlan;
 				_mtGood.reset(new MultipoleTransform(_type, _ell, _vmin, _vmax, 2*_veps,
-					strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding));
+					strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding,
+					MultipoleTransform::FastKernel, _precision));
 				_mtBetter.reset(new MultipoleTransform(_type, _ell, _vmin, _vmax, _veps,
-					strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding));
+					strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding,
+					MultipoleTransform::FastKernel, _precision));
 			}
 			return _veps;
 		}
-		// reduce veps by half and try again
-		_veps /= 2;
+		// The transform errors converge roughly as exp(-c/veps), so use the change in the
+		// error ratio since our last step to estimate c and predict how many halvings of
+		// veps are needed. The estimate is only trusted when the ratio decreased by at least
+		// a factor of 4, since a slow decrease predicts a jump that overshoots and the cost
+		// of a transform grows rapidly as veps decreases. Otherwise, just halve veps.
+		int halvings(1);
+		if(lastVeps > 0 && ratio > 0 && 4*ratio < lastRatio) {
+			double c = std::log(lastRatio/ratio)/(1/_veps - 1/lastVeps);
+			double target = 1/(1/_veps + std::log(ratio)/c);
+			halvings = (int)std::ceil(std::log(_veps/target)/std::log(2.));
+			// A jump costs two new transforms, so it only pays off beyond two halvings.
+			if(halvings < 3) halvings = 1;
+		}
+		// Do not jump past vepsMin
+		while(halvings > 1 && std::ldexp(_veps,-halvings) < vepsMin) --halvings;
+		lastVeps = _veps;
+		lastRatio = ratio;
+		lastHalvings = halvings;
+		_veps = std::ldexp(_veps,-halvings);
+		COSMO_COUNT(VepsHalvings,halvings);
 		if(_veps < vepsMin) {
 			throw RuntimeError("AdaptiveMultipoleTransform: reached vepsMin without convergence.");
 		}
-		_mtGood = _mtBetter;
-		_resultsGood.swap(_resultsBetter);
+		if(halvings == 1) {
+			// Our current "better" transform becomes the new "good" transform
+			_mtGood = _mtBetter;
+			_planGood.swap(_planBetter);
+			_resultsGood.swap(_resultsBetter);
+		}
+		else {
+			// Create a new "good" transform for the predicted veps
+			_mtGood.reset(new MultipoleTransform(_type, _ell, _vmin, _vmax, 2*_veps,
+				strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding,
+				MultipoleTransform::FastKernel, _precision));
+			_evaluate(f,_mtGood,_planGood,_resultsGood);
+		}
 		_mtBetter.reset(new MultipoleTransform(_type, _ell, _vmin, _vmax, _veps,
-			strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding));
-		_evaluate(f,_mtBetter,_resultsBetter);
+			strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding,
+			MultipoleTransform::FastKernel, _precision));
+		_evaluate(f,_mtBetter,_planBetter,_resultsBetter);
 	}
 }
 
+void local::AdaptiveMultipoleTransform::restore(double veps, int minSamplesPerDecade, bool optimize) {
+	if(veps <= 0) {
+		throw RuntimeError("AdaptiveMultipoleTransform::restore: expected veps > 0.");
+	}
+	MultipoleTransform::Strategy strategy(optimize ?
+		MultipoleTransform::MeasurePlan : MultipoleTransform::EstimatePlan);
+	int minSamplesPerCycle(2),interpolationPadding(3);
+	_veps = veps;
+	_sinceVerified = -1;
+	_mtGood.reset(new MultipoleTransform(_type, _ell, _vmin, _vmax, 2*_veps,
+		strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding,
+		MultipoleTransform::FastKernel, _precision));
+	_mtBetter.reset(new MultipoleTransform(_type, _ell, _vmin, _vmax, _veps,
+		strategy, minSamplesPerCycle, minSamplesPerDecade, interpolationPadding,
+		MultipoleTransform::FastKernel, _precision));
+}
+
 bool local::AdaptiveMultipoleTransform::transform(
 likely::GenericFunctionPtr f, std::vector<double> &result, bool bypassTerminationTest) const {
+	return _transform(f,result,bypassTerminationTest);
+}
+
+bool local::AdaptiveMultipoleTransform::transform(
+LogGridFunctionPtr f, std::vector<double> &result, bool bypassTerminationTest) const {
+	return _transform(f,result,bypassTerminationTest);
+}
+
+bool local::AdaptiveMultipoleTransform::_transform(
+Source const &f, std::vector<double> &result, bool bypassTerminationTest) const {
 	if(!_mtGood || !_mtBetter) {
 		throw RuntimeError("AdaptiveMultipoleTransform: must initialize before transforming.");
 	}
-	_evaluate(f,_mtBetter,_resultsBetter);
-	bool accurate(true);
-	if(!bypassTerminationTest) {
-		_evaluate(f,_mtGood,_resultsGood);
-		accurate = _isTerminated();
+	_evaluate(f,_mtBetter,_planBetter,_resultsBetter);
+	if(bypassTerminationTest || _policy == NeverVerify) {
+		_saveResult(result);
+		return true;
+	}
+	if(_needsVerification()) {
+		COSMO_COUNT(Verifications,1);
+		_evaluate(f,_mtGood,_planGood,_resultsGood);
+		_lastAccurate = _isTerminated();
+		_numVerifications++;
+		_sinceVerified = 0;
+		if(_policy == PeriodicVerify) _resultsVerified = _resultsBetter;
+	}
+	else {
+		_sinceVerified++;
 	}
 	_saveResult(result);
-	return accurate;
+	return _lastAccurate;
+}
+
+void local::AdaptiveMultipoleTransform::setVerificationPolicy(VerificationPolicy policy,
+int period, double maxDrift) {
+	if(policy != AlwaysVerify && policy != PeriodicVerify && policy != NeverVerify) {
+		throw RuntimeError("AdaptiveMultipoleTransform::setVerificationPolicy: invalid policy.");
+	}
+	if(policy == PeriodicVerify && period < 1) {
+		throw RuntimeError("AdaptiveMultipoleTransform::setVerificationPolicy: expected period >= 1.");
+	}
+	if(policy == PeriodicVerify && maxDrift < 0) {
+		throw RuntimeError("AdaptiveMultipoleTransform::setVerificationPolicy: expected maxDrift >= 0.");
+	}
+	_policy = policy;
+	_period = (policy == PeriodicVerify) ? period : 1;
+	_maxDrift = (policy == PeriodicVerify) ? maxDrift : 0;
+	// Always verify the next transform
+	_sinceVerified = -1;
+}
+
+bool local::AdaptiveMultipoleTransform::_needsVerification() const {
+	if(_policy == AlwaysVerify) return true;
+	// Verify the first transform, after any failure, and every _period transforms.
+	if(_sinceVerified < 0 || !_lastAccurate || _sinceVerified+1 >= _period) return true;
+	// Verify if the new result has drifted too far from the last verified result.
+	for(int i = 0; i < _vpoints.size(); ++i) {
+		double v(_vpoints[i]), fv(_resultsVerified[i]);
+		double norm = _relerr > 0 ?
+			std::fabs(fv) + _abserr*std::pow(v,_abspow)/_relerr : _abserr*std::pow(v,_abspow);
+		if(std::fabs(_resultsBetter[i] - fv) > _maxDrift*norm) return true;
+	}
+	return false;
 }
 
 double local::AdaptiveMultipoleTransform::getUMin() const {
@@ -197,6 +396,13 @@ int local::AdaptiveMultipoleTransform::getNU() const {
 	return _mtBetter->getUGrid().size();
 }
 
+std::vector<double> const &local::AdaptiveMultipoleTransform::getVGrid() const {
+	if(!_mtBetter) {
+		throw RuntimeError("AdaptiveMultipoleTransform::getVGrid: must initialize first.");
+	}
+	return _mtBetter->getVGrid();
+}
+
 double local::AdaptiveMultipoleTransform::getUSamplesPerDecade() const {
 	return getNU()/std::log10(getUMax()/getUMin());
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "likely/function.h"
 
 #include "boost/smart_ptr.hpp"
+#include "boost/function.hpp"
 
 #include <vector>
 
@@ -23,10 +24,20 @@ namespace cosmo {
 		// used to adaptively monitor numerical errors. The numerical termination
 		// criteria is that |f(2*veps) - f(veps)| < max(abserr*v^abspow,relerr*|f(veps)|)
 		// for each point v in vpoints. Transforms will be multiplied by the specified
-		// scale (which therefore affects the meaning of abserr).
+		// scale (which therefore affects the meaning of abserr). The precision option
+		// is passed to each MultipoleTransform that we create.
 		AdaptiveMultipoleTransform(MultipoleTransform::Type type, int ell, double scale,
-			std::vector<double> const &vpoints, double relerr, double abserr, double abspow = 0);
+			std::vector<double> const &vpoints, double relerr, double abserr, double abspow = 0,
+			MultipoleTransform::Precision precision = MultipoleTransform::DoublePrecision);
 		virtual ~AdaptiveMultipoleTransform();
+		// Evaluates a function at the logarithmically spaced points u[i] with
+		// log(u[i]) = logu0 + i*dlogu for i = 0,...,fu.size()-1 and stores the results
+		// in fu. Our u grids are always log spaced, so a function that can be evaluated
+		// more efficiently on such a grid (e.g., TabulatedPower::evaluateLogGrid) can be
+		// used instead of a GenericFunction in initialize() and transform().
+		typedef boost::function<void (double logu0, double dlogu, std::vector<double> &fu)>
+			LogGridFunction;
+		typedef boost::shared_ptr<LogGridFunction> LogGridFunctionPtr;
 		// Initializes for the specified function by automatically determining a suitable veps.
 		// The termination criteria provided in the constructor will be tighted by a factor
 		// 1/margin so that the nominal criteria are more likely to be met with other
@@ -34,29 +45,65 @@ namespace cosmo {
 		// vepsMax as a starting point. Otherwise, the veps value from the initialization is
 		// used as the starting point. The veps value is then successively halved until the
 		// termination criteria are met or we hit the vepsMin limit (which throws a
-		// RuntimeError). Results are stored in the vector provided, which will be
-		// resized if necessary. If optimize is true, then we perform an additional step
-		// of optimizing the FFTs that will be necessary for subsequent transforms. This
-		// optimization step takes at least a few seconds so is only worth doing if
-		// many transforms will be performed per initialization. Note that optimized
-		// transforms will generally give different numerical results at the level of
-		// roundoff errors. Returns the selected veps value.
+		// RuntimeError). After the first halving, the observed rate of convergence is used
+		// to predict how many further halvings are needed and, when this is more than two,
+		// we jump directly to the predicted veps. A jump that meets the criteria is followed
+		// by a bisection on the number of halvings since the last veps that failed, so the
+		// selected veps is the same as for a search using only single halvings (when errors
+		// decrease monotonically). We fall back to single halvings whenever the prediction
+		// is unreliable or too short. This prediction is opportunistic: the cost of each
+		// transform grows roughly as 1/veps, so a search is dominated by its final steps and
+		// skipping the early halvings saves little, while a jump that overshoots is costly.
+		// Results are stored in the vector provided, which will be resized if necessary.
+		// If optimize is true, then we perform an additional step of optimizing the FFTs
+		// that will be necessary for subsequent transforms. This optimization step takes at
+		// least a few seconds so is only worth doing if many transforms will be performed
+		// per initialization. Note that optimized transforms will generally give different
+		// numerical results at the level of roundoff errors. Returns the selected veps value.
 		double initialize(likely::GenericFunctionPtr f, std::vector<double> &result,
 			int minSamplesPerDecade= 40, double margin = 2,
 			double vepsMax = 0.01, double vepsMin = 1e-6, bool optimize = false);
+		double initialize(LogGridFunctionPtr f, std::vector<double> &result,
+			int minSamplesPerDecade= 40, double margin = 2,
+			double vepsMax = 0.01, double vepsMin = 1e-6, bool optimize = false);
+		// Initializes using a veps value determined previously (e.g., by an earlier call to
+		// initialize() with the same inputs) without any search, so that transform() can be
+		// called immediately. See initialize() for the other parameters.
+		void restore(double veps, int minSamplesPerDecade = 40, bool optimize = false);
 		// Calculates the transform of the specified function using the veps determined
 		// from the most recent call to initialize(). Results are stored in the vector
 		// provided, which will be resized if necessary. Returns true if the termination
-		// criteria are met, unless bypassTerminationTest is true (in which case we
-		// always return true and transforms will be somewhat faster).
+		// criteria were met at the most recent verification (see setVerificationPolicy),
+		// unless bypassTerminationTest is true (in which case we always return true and
+		// never verify, so transforms will be faster).
 		bool transform(likely::GenericFunctionPtr f, std::vector<double> &result,
 			bool bypassTerminationTest = false) const;
+		bool transform(LogGridFunctionPtr f, std::vector<double> &result,
+			bool bypassTerminationTest = false) const;
+		// Policies for verifying the termination criteria in transform(), which requires
+		// a second transform with 2*veps and roughly doubles its cost:
+		//  - AlwaysVerify checks every transform (the default).
+		//  - PeriodicVerify checks every period transforms, and also whenever the
+		//    result has drifted from the last verified result by more than maxDrift,
+		//    measured in units of |result| + abserr*v^abspow/relerr at each v, or the
+		//    last verification failed. The error of a transform is linear in its input,
+		//    so small changes since a successful verification give small changes in error.
+		//  - NeverVerify never checks, which is equivalent to always bypassing the test.
+		// The first transform after initialize() or restore() is always verified when
+		// the policy is not NeverVerify.
+		enum VerificationPolicy { AlwaysVerify, PeriodicVerify, NeverVerify };
+		void setVerificationPolicy(VerificationPolicy policy, int period = 10, double maxDrift = 0.1);
+		VerificationPolicy getVerificationPolicy() const;
+		// Returns the number of verification transforms performed since we were created.
+		long getNumVerifications() const;
 		// Returns our relative error target.
 		double getRelErr() const;
 		// Returns our absolute error target.
 		double getAbsErr() const;
 		// Returns the exponent of the r-weighting used for our absolute error estimate.
 		double getAbsPow() const;
+		// Returns the floating-point precision used for our FFT convolutions.
+		MultipoleTransform::Precision getPrecision() const;
 		// Returns the value of veps from our last initialization, or 0 if we have never
 		// been initialized.
 		double getVEps() const;
@@ -66,19 +113,55 @@ namespace cosmo {
 		double getUMin() const;
 		double getUMax() const;
 		int getNU() const;
+		// Returns the log-spaced grid of v values where our transform is calculated before
+		// being interpolated to the vpoints provided in our constructor, based on our last
+		// initialization (or throws a RuntimeError if we have never been initialized).
+		// Any vpoints that coincide with this grid are not interpolated.
+		std::vector<double> const &getVGrid() const;
 		// Returns the number of u samples per decade n/log10(umax/umin).
 		double getUSamplesPerDecade() const;
+		// Returns the largest ratio of |good - better| to our termination tolerance
+		// max(abserr*v^abspow,relerr*|better|)/margin at any of our vpoints, where good and
+		// better are results tabulated at our vpoints using 2*veps and veps. The termination
+		// criteria are met when this ratio is <= 1.
+		double getErrorRatio(std::vector<double> const &good, std::vector<double> const &better,
+			double margin = 1) const;
 	private:
 		MultipoleTransform::Type _type;
+		MultipoleTransform::Precision _precision;
 		int _ell;
 		std::vector<double> _vpoints;
 		mutable std::vector<double> _resultsGood, _resultsBetter;
 		double _scale, _relerr, _abserr, _abspow, _vmin, _vmax, _veps;
 		typedef boost::shared_ptr<const MultipoleTransform> MultipoleTransformCPtr;
 		MultipoleTransformCPtr _mtGood, _mtBetter;
-		void _evaluate(likely::GenericFunctionPtr f,
-			MultipoleTransformCPtr transform, std::vector<double> &result) const;
+		// Precomputed interpolation from a transform's v grid to our vpoints, together with
+		// reusable workspaces, that is (re)built the first time each transform is evaluated.
+		struct EvaluationPlan;
+		typedef boost::scoped_ptr<EvaluationPlan> EvaluationPlanPtr;
+		mutable EvaluationPlanPtr _planGood, _planBetter;
+		// Wraps the function to transform, which is provided either pointwise or on a log grid.
+		struct Source {
+			Source(likely::GenericFunctionPtr f) : pointwise(f) { }
+			Source(LogGridFunctionPtr f) : logGrid(f) { }
+			likely::GenericFunctionPtr pointwise;
+			LogGridFunctionPtr logGrid;
+		};
+		double _initialize(Source const &f, std::vector<double> &result, int minSamplesPerDecade,
+			double margin, double vepsMax, double vepsMin, bool optimize);
+		bool _transform(Source const &f, std::vector<double> &result,
+			bool bypassTerminationTest) const;
+		void _evaluate(Source const &f, MultipoleTransformCPtr transform,
+			EvaluationPlanPtr &plan, std::vector<double> &result) const;
 		bool _isTerminated(double margin = 1) const;
+		VerificationPolicy _policy;
+		int _period;
+		double _maxDrift;
+		mutable int _sinceVerified;
+		mutable long _numVerifications;
+		mutable bool _lastAccurate;
+		mutable std::vector<double> _resultsVerified;
+		bool _needsVerification() const;
 		void _saveResult(std::vector<double> &result) const;
 	}; // AdaptiveMultipoleTransform
 
@@ -86,6 +169,12 @@ namespace cosmo {
 	inline double AdaptiveMultipoleTransform::getAbsErr() const { return _abserr; }
 	inline double AdaptiveMultipoleTransform::getAbsPow() const { return _abspow; }
 	inline double AdaptiveMultipoleTransform::getVEps() const { return _veps; }
+	inline AdaptiveMultipoleTransform::VerificationPolicy
+	AdaptiveMultipoleTransform::getVerificationPolicy() const { return _policy; }
+	inline long AdaptiveMultipoleTransform::getNumVerifications() const { return _numVerifications; }
+	inline MultipoleTransform::Precision AdaptiveMultipoleTransform::getPrecision() const {
+		return _precision;
+	}
 
 } // cosmo
 
@@ -3,15 +3,18 @@
 #include "cosmo/BaryonPerturbations.h"
 #include "cosmo/RuntimeError.h"
 #include "cosmo/AbsHomogeneousUniverse.h"
+#include "cosmo/TabulatedPower.h"
 
 #include <cmath>
+#include <vector>
 
 namespace local = cosmo;
 
 local::BaryonPerturbations::BaryonPerturbations(double omegaMatter, double omegaBaryon,
 double hubbleConstant, double cmbTemperature, BaoOption baoOption)
 : _omegaMatter(omegaMatter), _omegaBaryon(omegaBaryon),
-_hubbleConstant(hubbleConstant), _cmbTemperature(cmbTemperature), _baoOption(baoOption)
+_hubbleConstant(hubbleConstant), _cmbTemperature(cmbTemperature), _baoOption(baoOption),
+_tabKMin(0), _tabKMax(0)
 {
     if(omegaMatter < 0) {
         throw RuntimeError("BaryonPerturbation: invalid omegaMatter < 0.");
@@ -78,6 +81,34 @@ _hubbleConstant(hubbleConstant), _cmbTemperature(cmbTemperature), _baoOption(bao
 
 local::BaryonPerturbations::~BaryonPerturbations() { }
 
+void local::BaryonPerturbations::tabulate(double kmin, double kmax, int samplesPerDecade) {
+    _tabBaryon.reset();
+    _tabCdm.reset();
+    _tabFull.reset();
+    _tabNw.reset();
+    if(0 == samplesPerDecade) return;
+    if(kmin <= 0 || kmax <= kmin) {
+        throw RuntimeError("BaryonPerturbations::tabulate: expected 0 < kmin < kmax.");
+    }
+    if(samplesPerDecade < 0) {
+        throw RuntimeError("BaryonPerturbations::tabulate: expected samplesPerDecade >= 0.");
+    }
+    int nk = 1 + (int)std::ceil(samplesPerDecade*std::log10(kmax/kmin));
+    if(nk < 3) nk = 3;
+    std::vector<double> kgrid(nk), baryon, cdm, full, nw;
+    double dlogk = std::log(kmax/kmin)/(nk-1);
+    for(int i = 0; i < nk; ++i) {
+        kgrid[i] = (i == nk-1) ? kmax : kmin*std::exp(i*dlogk);
+    }
+    calculateTransferFunctions(kgrid,baryon,cdm,full,nw,_baoOption);
+    _tabKMin = kmin;
+    _tabKMax = kmax;
+    _tabBaryon.reset(new TabulatedPower(kgrid,baryon));
+    _tabCdm.reset(new TabulatedPower(kgrid,cdm));
+    _tabFull.reset(new TabulatedPower(kgrid,full));
+    _tabNw.reset(new TabulatedPower(kgrid,nw));
+}
+
 #include <iostream>
 
 double local::BaryonPerturbations::getNode(int n) const {
@@ -89,42 +120,116 @@ double local::BaryonPerturbations::getNode(int n) const {
 }
 
 double local::BaryonPerturbations::getCdmTransfer(double kMpch) const {
-    if(kMpch != _kSave) {
-        calculateTransferFunctions(kMpch,_Tf_baryon,_Tf_cdm,_Tf_full,_Tf_nw,_baoOption);
-        _kSave = kMpch;
-    }
-    return _Tf_cdm;
+    if(_tabCdm && kMpch >= _tabKMin && kMpch <= _tabKMax) return (*_tabCdm)(kMpch);
+    double Tf_baryon, Tf_cdm, Tf_full, Tf_nw;
+    calculateTransferFunctions(kMpch,Tf_baryon,Tf_cdm,Tf_full,Tf_nw,_baoOption);
+    return Tf_cdm;
 }
 
 double local::BaryonPerturbations::getBaryonTransfer(double kMpch) const {
-    if(kMpch != _kSave) {
-        calculateTransferFunctions(kMpch,_Tf_baryon,_Tf_cdm,_Tf_full,_Tf_nw,_baoOption);
-        _kSave = kMpch;
-    }
-    return _Tf_baryon;
+    if(_tabBaryon && kMpch >= _tabKMin && kMpch <= _tabKMax) return (*_tabBaryon)(kMpch);
+    double Tf_baryon, Tf_cdm, Tf_full, Tf_nw;
+    calculateTransferFunctions(kMpch,Tf_baryon,Tf_cdm,Tf_full,Tf_nw,_baoOption);
+    return Tf_baryon;
 }
 
 double local::BaryonPerturbations::getMatterTransfer(double kMpch) const {
-    if(kMpch != _kSave) {
-        calculateTransferFunctions(kMpch,_Tf_baryon,_Tf_cdm,_Tf_full,_Tf_nw,_baoOption);
-        _kSave = kMpch;
-    }
-    return _Tf_full;
+    if(_tabFull && kMpch >= _tabKMin && kMpch <= _tabKMax) return (*_tabFull)(kMpch);
+    double Tf_baryon, Tf_cdm, Tf_full, Tf_nw;
+    calculateTransferFunctions(kMpch,Tf_baryon,Tf_cdm,Tf_full,Tf_nw,_baoOption);
+    return Tf_full;
 }
 
 double local::BaryonPerturbations::getNoWigglesTransfer(double kMpch) const {
-    if(kMpch != _kSave) {
-        calculateTransferFunctions(kMpch,_Tf_baryon,_Tf_cdm,_Tf_full,_Tf_nw,_baoOption);
-        _kSave = kMpch;
+    if(_tabNw && kMpch >= _tabKMin && kMpch <= _tabKMax) return (*_tabNw)(kMpch);
+    double Tf_baryon, Tf_cdm, Tf_full, Tf_nw;
+    calculateTransferFunctions(kMpch,Tf_baryon,Tf_cdm,Tf_full,Tf_nw,_baoOption);
+    return Tf_nw;
+}
+
+void local::BaryonPerturbations::calculateTransferFunctions(std::vector<double> const &kMpch,
+std::vector<double> &Tf_baryon, std::vector<double> &Tf_cdm, std::vector<double> &Tf_full,
+std::vector<double> &Tf_nw, BaoOption baoOption) const {
+    int nk(kMpch.size());
+    if(Tf_baryon.size() != nk) Tf_baryon.resize(nk);
+    if(Tf_cdm.size() != nk) Tf_cdm.resize(nk);
+    if(Tf_full.size() != nk) Tf_full.resize(nk);
+    if(Tf_nw.size() != nk) Tf_nw.resize(nk);
+    if(0 == nk) return;
+    double const *kh = &kMpch[0];
+    double *baryon = &Tf_baryon[0], *cdm = &Tf_cdm[0], *full = &Tf_full[0], *nw = &Tf_nw[0];
+    // This follows the single-k calculation above, but with the k-independent terms
+    // hoisted out of the loops and all powers of k derived from a single log(k). The
+    // baoOption branch is also moved out of the loops, so that each loop body is a
+    // straight sequence of arithmetic and math library calls. Results agree with the
+    // single-k calculation up to rounding.
+    double h(_hubbleConstant), s(_sound_horizon);
+    double qScale(1/(13.41*_k_equality)), logQScale(std::log(qScale));
+    double logKSilk(std::log(_k_silk));
+    double C_alpha0(14.2/_alpha_c), beta_c18(1.8*_beta_c);
+    double nwScale(0.43*_sound_horizon_fit), nwAlpha(_alpha_gamma), nwBeta(1-_alpha_gamma);
+    double alpha_b(_alpha_b), beta_b(_beta_b);
+    for(int i = 0; i < nk; ++i) {
+        double k(kh[i]*h), logk(std::log(k));
+        double q(k*qScale), qSq(q*q);
+        double xx(k*s);
+        double T_c_ln_beta(std::log(2.718282+beta_c18*q));
+        double T_c_ln_nobeta(std::log(2.718282+1.8*q));
+        double T_c_C(386.0/(1+69.9*std::exp(1.08*(logk + logQScale))));
+        double T_c_C_alpha(C_alpha0 + T_c_C), T_c_C_noalpha(14.2 + T_c_C);
+        double tmp(xx*(1/5.4)), tmp2(tmp*tmp);
+        double T_c_f(1.0/(1.0+tmp2*tmp2));
+        cdm[i] = T_c_f*T_c_ln_beta/(T_c_ln_beta+T_c_C_noalpha*qSq) +
+            (1-T_c_f)*T_c_ln_beta/(T_c_ln_beta+T_c_C_alpha*qSq);
+        double T_b_T0(T_c_ln_nobeta/(T_c_ln_nobeta+T_c_C_noalpha*qSq));
+        tmp = xx*(1/5.2);
+        double silk(std::exp(-std::exp(1.4*(logk - logKSilk))));
+        tmp2 = beta_b/xx;
+        baryon[i] = T_b_T0/(1+tmp*tmp) + alpha_b/(1+tmp2*tmp2*tmp2)*silk;
+        tmp = nwScale*k;
+        tmp2 = tmp*tmp;
+        double q_eff(q/(nwAlpha + nwBeta/(1+tmp2*tmp2)));
+        double L0 = std::log(2.0*2.718282+1.8*q_eff);
+        double C0 = 14.2 + 731.0/(1+62.5*q_eff);
+        nw[i] = L0/(L0 + C0*q_eff*q_eff);
+    }
+    // Add baryon acoustic oscillations
+    if(baoOption == PeriodicOscillation) {
+        for(int i = 0; i < nk; ++i) {
+            double xx(kh[i]*h*s);
+            baryon[i] *= std::sin(xx)/xx;
+        }
+    }
+    else if(baoOption == NoOscillation) {
+        // See the single-k calculation for details.
+        for(int i = 0; i < nk; ++i) {
+            double k(kh[i]*h), tmp(_beta_node/(k*s));
+            double xx_tilde(k*s*std::pow(1+tmp*tmp*tmp,-1./3.)), tmp2(xx_tilde*xx_tilde);
+            baryon[i] /= std::sqrt(std::sqrt(1+tmp2*tmp2));
+        }
+    }
+    else {
+        for(int i = 0; i < nk; ++i) {
+            double k(kh[i]*h), tmp(_beta_node/(k*s));
+            double xx_tilde(k*s*std::pow(1+tmp*tmp*tmp,-1./3.));
+            baryon[i] *= std::sin(xx_tilde)/xx_tilde;
+        }
+    }
+    double f_baryon(_obhh/_omhh);
+    for(int i = 0; i < nk; ++i) {
+        full[i] = f_baryon*baryon[i] + (1-f_baryon)*cdm[i];
+    }
+    // Handle k = 0 the same way as the single-k calculation.
+    for(int i = 0; i < nk; ++i) {
+        if(0 == kh[i]) baryon[i] = cdm[i] = full[i] = nw[i] = 1;
     }
-    return _Tf_nw;
 }
 
 void local::BaryonPerturbations::calculateTransferFunctions(double kMpch,
 double &Tf_baryon, double &Tf_cdm, double &Tf_full, double &Tf_nw, BaoOption baoOption) const {
 
     if(0 == kMpch) {
-        Tf_baryon = Tf_cdm = Tf_full = 1;
+        Tf_baryon = Tf_cdm = Tf_full = Tf_nw = 1;
         return;
     }
 
@@ -3,10 +3,16 @@
 #ifndef COSMO_BARYON_PERTURBATIONS
 #define COSMO_BARYON_PERTURBATIONS
 
+#include "cosmo/types.h"
+
+#include <vector>
+
 namespace cosmo {
     // Calculates baryon perturbations to a homogenous universe using the results in
     // Eisenstein & Hu, "Baryonic Features in the Matter Transfer Function", astro-ph/9709112
     // Code adapted from http://background.uchicago.edu/~whu/transfer/transferpage.html
+    // All const methods are reentrant, so a single instance can be shared between threads
+    // (but tabulate() must not be called while other threads are using this object).
 	class BaryonPerturbations {
 	public:
         // Options for including baryon acoustic oscillations in the transfer function calculation.
@@ -34,6 +40,8 @@ namespace cosmo {
         double getSoundHorizonFit() const;
         // Returns the wavenumber in 1/(Mpc/h) characterizing baryon-photon diffusion.
         double getSilkDampingScale() const;
+        // The following methods evaluate one transfer function at a single wavenumber. When
+        // several transfer functions are needed, calculateTransferFunctions is faster.
         // Returns the CDM transfer function value at the specified wavenumber in 1/(Mpc/h).
         double getCdmTransfer(double kMpch) const;
         // Returns the baryon transfer function value at the specified wavenumber
@@ -50,6 +58,25 @@ namespace cosmo {
         void calculateTransferFunctions(double kMpch,
             double &Tf_baryon, double &Tf_cdm, double &Tf_full, double &Tf_nw,
             BaoOption baoOption = ShiftedOscillation) const;
+        // Calculates the same transfer functions for each of the specified wavenumbers,
+        // storing the results in the vectors provided, which will be resized if necessary.
+        // Always uses the exact calculation, even if we are tabulated. This is about 1.5x
+        // faster than the single-k version for each wavenumber and agrees up to rounding.
+        void calculateTransferFunctions(std::vector<double> const &kMpch,
+            std::vector<double> &Tf_baryon, std::vector<double> &Tf_cdm,
+            std::vector<double> &Tf_full, std::vector<double> &Tf_nw,
+            BaoOption baoOption = ShiftedOscillation) const;
+        // Tabulates all four transfer functions at log-spaced wavenumbers covering
+        // kmin <= k <= kmax in 1/(Mpc/h) with the specified number of samples per decade.
+        // Subsequent calls to the get...Transfer methods with k in this range use cubic
+        // spline interpolation in log(k) instead of the exact calculation, and values
+        // outside this range are still calculated exactly. With the default settings and
+        // typical cosmologies, the interpolation errors are below 5e-9 (absolute) and 1e-5
+        // (relative), with the largest relative errors near kmax. Errors scale roughly as
+        // samplesPerDecade^-4 in the interior. Use samplesPerDecade = 0 to disable tabulation.
+        void tabulate(double kmin = 1e-4, double kmax = 1e2, int samplesPerDecade = 400);
+        // Returns true if the transfer functions are tabulated.
+        bool isTabulated() const;
         // Returns the value of k*s/pi for the n-th node of the BAO oscillation (n=1,2,3,...)
         // where s is the sound horizon. Values approach n for large n but are generally
         // larger for the first few nodes. See eqn. (22).
@@ -76,7 +103,8 @@ namespace cosmo {
         	_k_peak,		/* Fit to wavenumber of first peak, in Mpc^-1 */
         	_sound_horizon_fit,	/* Fit to sound horizon, in Mpc */
         	_alpha_gamma;	/* Gamma suppression in approximate TF */
-        mutable double _Tf_baryon, _Tf_cdm, _Tf_full, _Tf_nw, _kSave;
+        double _tabKMin, _tabKMax;
+        TabulatedPowerCPtr _tabBaryon, _tabCdm, _tabFull, _tabNw;
 	}; // BaryonPerturbations
 	
 	inline double BaryonPerturbations::getMatterRadiationEqualityRedshift() const {
@@ -97,6 +125,9 @@ namespace cosmo {
 	inline double BaryonPerturbations::getSilkDampingScale() const {
         return _k_silk/_hubbleConstant;
 	}
+	inline bool BaryonPerturbations::isTabulated() const {
+        return !!_tabFull;
+	}
 	
 } // cosmo
 
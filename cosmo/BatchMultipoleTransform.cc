@@ -0,0 +1,322 @@
+// Created 18-Oct-2026
+
+#include "cosmo/BatchMultipoleTransform.h"
+#include "cosmo/RuntimeError.h"
+#include "cosmo/Instrumentation.h"
+
+#include "config.h"
+#ifdef HAVE_LIBFFTW3
+#include "fftw3.h"
+#define FFTW(X) fftw_ ## X // double transforms
+#endif
+
+#include <boost/math/special_functions/gamma.hpp>
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+namespace local = cosmo;
+
+namespace cosmo {
+    struct BatchMultipoleTransform::Implementation {
+#ifdef HAVE_LIBFFTW3
+        FFTW(complex) *fdata,*hdata,*gdata;
+        FFTW(plan) gplan,fgplan;
+#endif
+    };
+} // cosmo::
+
+local::BatchMultipoleTransform::BatchMultipoleTransform(MultipoleTransform::Type type,
+std::vector<int> const &ells, double vmin, double vmax, std::vector<double> const &veps,
+MultipoleTransform::Strategy strategy, int minSamplesPerCycle, int minSamplesPerDecade,
+int interpolationPadding) :
+_ells(ells), _pimpl(new Implementation())
+{
+#ifndef HAVE_LIBFFTW3
+	throw RuntimeError("BatchMultipoleTransform: library not built with fftw3 support.");
+#endif
+	// Input parameter validation
+	if(type != MultipoleTransform::SphericalBessel && type != MultipoleTransform::Hankel) {
+		throw RuntimeError("BatchMultipoleTransform: invalid type.");
+	}
+	int nell(_ells.size());
+	if(nell == 0) {
+		throw RuntimeError("BatchMultipoleTransform: expected at least one multipole.");
+	}
+	if(veps.size() != nell) {
+		throw RuntimeError("BatchMultipoleTransform: expected one veps value per multipole.");
+	}
+	if(vmin >= vmax) {
+		throw RuntimeError("BatchMultipoleTransform: expected vmin < vmax.");
+	}
+	if(vmin <= 0) {
+		throw RuntimeError("BatchMultipoleTransform: expected vmin > 0.");
+	}
+	if(minSamplesPerCycle <= 0) {
+		throw RuntimeError("BatchMultipoleTransform: expected minSamplesPerCycle > 0.");
+	}
+	if(minSamplesPerDecade < 0) {
+		throw RuntimeError("BatchMultipoleTransform: expected minSamplesPerDecade >= 0.");
+	}
+	double pi(atan2(0,-1));
+	// Calculate the parameters of each multipole's kernel, following the same steps
+	// (and equation numbers) as the MultipoleTransform constructor.
+	std::vector<double> alpha(nell), lnuv0(nell), sN(nell);
+	double ds(0);
+	for(int i = 0; i < nell; ++i) {
+		int ell(_ells[i]);
+		if(ell < 0) {
+			throw RuntimeError("BatchMultipoleTransform: expected ell >= 0.");
+		}
+		if(veps[i] == 0) {
+			throw RuntimeError("BatchMultipoleTransform: expected veps != 0.");
+		}
+		double uv0, s0;
+		if(type == MultipoleTransform::SphericalBessel) {
+			// Calculate alpha and uv0 of eqn (1.6) and s0 of eqn (1.8)
+			alpha[i] = 0.5*(1-ell);
+			uv0 = 2*std::pow(boost::math::tgamma(ell+1.5)/std::sqrt(pi),1./(ell+1));
+			s0 = 2./(ell+1);
+		}
+		else {
+			// Calculate alpha and uv0 of eqn (2.4) and s0 of eqn (2.6)
+			alpha[i] = 0.25*(1-2*ell);
+			uv0 = 2*std::pow(boost::math::tgamma(ell+1)/std::sqrt(pi),1./(ell+0.5));
+			s0 = 4./(2*ell+1);
+		}
+		lnuv0[i] = std::log(uv0);
+		// Calculate c of eqn (3.4) and eps using the approx of eqn (3.7)
+		double eps, arg, c = 2*pi/minSamplesPerCycle/uv0;
+		if(veps[i] > 0) {
+			double L0 = veps[i]/c;
+			if(L0 > 0.35) {
+				throw RuntimeError("BatchMultipoleTransform: veps to large for eqn (3.9) approx.");
+			}
+			double L1 = std::log(L0), L2 = std::log(-L1), L1sq(L1*L1);
+			arg = 6*L1sq*L1sq + 6*L1sq*L2*(L1+1) - 3*L1*L2*(L2-2) + L2*(2*L2*L2-9*L2+6);
+			eps = std::pow(-L0/(6*L1sq*L1)*arg,1./s0);
+		}
+		else {
+			eps = -veps[i];
+		}
+		// Calculate Y of eqn (3.3), delta and sN of eqn (3.2)
+		double Y = uv0/(2*pi)*std::pow(eps,-s0);
+		if(type == MultipoleTransform::SphericalBessel) {
+			arg = std::ceil(Y)/Y;
+		}
+		else {
+			arg = (std::ceil(1./8.+Y/4.) - 1./8.)/Y;
+		}
+		sN[i] = -s0*std::log(eps) + std::log(arg);
+		// Calculate dsmax of eqn (3.4) and use the smallest value of any multipole
+		double dsmax = c*std::pow(eps,s0);
+		if(minSamplesPerDecade > 0) {
+			double dsmaxAlt = std::log(10)/minSamplesPerDecade;
+			if(dsmaxAlt < dsmax) dsmax = dsmaxAlt;
+		}
+		if(i == 0 || dsmax < ds) ds = dsmax;
+	}
+	// Pick a common value of u*v at the center of the union of all kernel windows,
+	// then find the range of grid offsets covered by each kernel.
+	double lnlo(lnuv0[0]-sN[0]), lnhi(lnuv0[0]+sN[0]);
+	for(int i = 1; i < nell; ++i) {
+		lnlo = std::min(lnlo,lnuv0[i]-sN[i]);
+		lnhi = std::max(lnhi,lnuv0[i]+sN[i]);
+	}
+	double lnuvc = 0.5*(lnlo+lnhi), uvc = std::exp(lnuvc);
+	// Each kernel is truncated at |s-s0| = sN, which MultipoleTransform arranges to fall
+	// exactly on a sample at a zero of the kernel. With a common grid this is not
+	// possible for every multipole, so we instead extend the oscillating upper tail of
+	// each kernel with a smooth cosine taper, which suppresses the truncation error.
+	// A taper over 16 samples (at least 8 cycles) gives errors comparable to or smaller
+	// than MultipoleTransform with the same veps.
+	double taper(16);
+	std::vector<double> tlo(nell), thi(nell);
+	std::vector<int> nlo(nell), nhi(nell);
+	int nmin(0), nmax(0);
+	for(int i = 0; i < nell; ++i) {
+		tlo[i] = (lnuv0[i] - sN[i] - lnuvc)/ds;
+		thi[i] = (lnuv0[i] + sN[i] - lnuvc)/ds;
+		nlo[i] = (int)std::ceil(tlo[i]);
+		nhi[i] = (int)std::floor(thi[i] + taper);
+		nmin = std::min(nmin,nlo[i]);
+		nmax = std::max(nmax,nhi[i]);
+	}
+	// Calculate Ng of eqn (3.1) and the total grid size needed to keep our v grid
+	// free of aliasing for every multipole.
+	int Ng = (int)std::ceil(std::log(vmax/vmin)/(2*ds)+interpolationPadding);
+	_Ntot = Ng + std::max(nmax,1-nmin);
+	int L = 2*_Ntot;
+	double v0 = std::sqrt(vmin*vmax), u0 = uvc/v0;
+	double u02 = u0*u0, u03 = u0*u02;
+	// Tabulate the shared u and v grids and the per-multipole rescaling coefficients
+	_cleanBegin = nmax;
+	_cleanEnd = L + nmin;
+	_ugrid.reserve(L);
+	_vgrid.reserve(_cleanEnd - _cleanBegin);
+	_coef.resize(nell);
+	_scale.resize(nell);
+	for(int n = -_Ntot; n < _Ntot; ++n) {
+		double s = n*ds;
+		_ugrid.push_back(u0*std::exp(-s));
+		if(n + _Ntot >= _cleanBegin && n + _Ntot < _cleanEnd) {
+			_vgrid.push_back(v0*std::exp(+s));
+		}
+	}
+	for(int i = 0; i < nell; ++i) {
+		_coef[i].reserve(L);
+		_scale[i].reserve(_cleanEnd - _cleanBegin);
+		for(int n = -_Ntot; n < _Ntot; ++n) {
+			double s = n*ds;
+			if(type == MultipoleTransform::SphericalBessel) {
+				_coef[i].push_back(ds*std::exp((3-alpha[i])*(-s))*u03);
+			}
+			else {
+				_coef[i].push_back(ds*std::exp((2-alpha[i])*(-s))*u02);
+			}
+			if(n + _Ntot >= _cleanBegin && n + _Ntot < _cleanEnd) {
+				_scale[i].push_back(std::exp(-alpha[i]*s)/ds);
+			}
+		}
+	}
+#ifdef HAVE_LIBFFTW3
+	// Our inputs and kernels are all real, so we pack the multipoles in pairs into the
+	// real and imaginary parts of a single complex FFT, which halves the number of FFTs.
+	int npair = (nell+1)/2;
+	_pimpl->fdata = (FFTW(complex)*)FFTW(malloc)(sizeof(FFTW(complex))*npair*L);
+	_pimpl->hdata = (FFTW(complex)*)FFTW(malloc)(sizeof(FFTW(complex))*npair*L);
+	_pimpl->gdata = (FFTW(complex)*)FFTW(malloc)(sizeof(FFTW(complex))*npair*L);
+	// Build batched plans that transform all pairs in a single pass.
+	int flags = (strategy == MultipoleTransform::EstimatePlan) ? FFTW_ESTIMATE : FFTW_MEASURE;
+	_pimpl->gplan = FFTW(plan_many_dft)(1,&L,npair,_pimpl->gdata,0,1,L,
+		_pimpl->gdata,0,1,L,FFTW_FORWARD,flags);
+	_pimpl->fgplan = FFTW(plan_many_dft)(1,&L,npair,_pimpl->gdata,0,1,L,
+		_pimpl->gdata,0,1,L,FFTW_BACKWARD,flags);
+	// Tabulate each kernel at offsets n*ds relative to the common u*v value, including
+	// the normalization of the inverse transform, packing each pair as for our inputs.
+	FFTW(plan) fplan = FFTW(plan_many_dft)(1,&L,npair,_pimpl->fdata,0,1,L,
+		_pimpl->fdata,0,1,L,FFTW_FORWARD,FFTW_ESTIMATE);
+	for(int m = 0; m < npair*L; ++m) {
+		_pimpl->fdata[m][0] = _pimpl->fdata[m][1] = 0;
+	}
+	for(int i = 0; i < nell; ++i) {
+		int ell(_ells[i]), part(i%2);
+		FFTW(complex) *fdata = _pimpl->fdata + (i/2)*L;
+		#pragma omp parallel for
+		for(int m = 0; m < L; ++m) {
+			int n = m;
+			if(n >= _Ntot) n -= L;
+			if(n >= nlo[i] && n <= nhi[i]) {
+				double bessel,s = n*ds, xarg = uvc*std::exp(s);
+				if(type == MultipoleTransform::SphericalBessel) {
+					bessel = sphericalBesselJ(ell,xarg);
+				}
+				else {
+					bessel = cylindricalBesselJ(ell,xarg);
+				}
+				double weight = (n <= thi[i]) ? 1 : 0.5*(1+std::cos(pi*(n-thi[i])/taper));
+				fdata[m][part] = std::exp(alpha[i]*s)*bessel*ds*weight/L;
+			}
+		}
+	}
+	FFTW(execute)(fplan);
+	FFTW(destroy_plan)(fplan);
+	// Each packed kernel transform is K = Ka + i*Kb, where Ka and Kb are the hermitian
+	// transforms of the pair's real kernels. Similarly, each packed input transform is
+	// Z = A + i*B and the transform of the packed pair of convolutions is W = A*Ka + i*B*Kb.
+	// Since A[m] = (Z[m] + conj(Z[L-m]))/2 and i*B[m] = (Z[m] - conj(Z[L-m]))/2, this is
+	// W[m] = Z[m]*P[m] + conj(Z[L-m])*Q[m] with P = (Ka+Kb)/2 and Q = (Ka-Kb)/2, which
+	// we store in fdata and hdata.
+	for(int pair = 0; pair < npair; ++pair) {
+		FFTW(complex) *fdata = _pimpl->fdata + pair*L, *hdata = _pimpl->hdata + pair*L;
+		for(int m = 0; m <= L/2; ++m) {
+			int mc = (L - m)%L;
+			// Unpack Ka and Kb at m and at L-m
+			double kre(fdata[m][0]), kim(fdata[m][1]), kcre(fdata[mc][0]), kcim(fdata[mc][1]);
+			double are = 0.5*(kre + kcre), aim = 0.5*(kim - kcim);
+			double bre = 0.5*(kim + kcim), bim = 0.5*(kcre - kre);
+			// Ka[L-m] = conj(Ka[m]) and Kb[L-m] = conj(Kb[m])
+			fdata[m][0] = 0.5*(are + bre);
+			fdata[m][1] = 0.5*(aim + bim);
+			hdata[m][0] = 0.5*(are - bre);
+			hdata[m][1] = 0.5*(aim - bim);
+			fdata[mc][0] = fdata[m][0];
+			fdata[mc][1] = -fdata[m][1];
+			hdata[mc][0] = hdata[m][0];
+			hdata[mc][1] = -hdata[m][1];
+		}
+	}
+#endif
+}
+
+local::BatchMultipoleTransform::~BatchMultipoleTransform() {
+#ifdef HAVE_LIBFFTW3
+    FFTW(destroy_plan)(_pimpl->gplan);
+    FFTW(destroy_plan)(_pimpl->fgplan);
+    FFTW(free)(_pimpl->fdata);
+    FFTW(free)(_pimpl->hdata);
+    FFTW(free)(_pimpl->gdata);
+#endif
+}
+
+void local::BatchMultipoleTransform::transform(
+std::vector<std::vector<double> > const &funcTables,
+std::vector<std::vector<double> > &results) const {
+#ifndef HAVE_LIBFFTW3
+	throw RuntimeError("BatchMultipoleTransform: library not built with fftw3 support.");
+#else
+	COSMO_TIME(FftTime);
+	COSMO_COUNT(FftExecutions,2);
+	int nell(_ells.size()), npair((nell+1)/2), L(2*_Ntot), nv(_vgrid.size());
+	if(funcTables.size() != nell) {
+		throw RuntimeError("BatchMultipoleTransform::transform: expected one table per multipole.");
+	}
+	// (re)initialize result vectors to have correct size, if necessary
+	if(results.size() != nell) results.resize(nell);
+	// Pack pairs of real inputs into the real and imaginary parts of each complex FFT
+	for(int i = 0; i < nell; ++i) {
+		if(funcTables[i].size() != L) {
+			throw RuntimeError("BatchMultipoleTransform::transform: funcTable has wrong size.");
+		}
+		if(results[i].size() != nv) std::vector<double>(nv,0).swap(results[i]);
+		FFTW(complex) *gdata = _pimpl->gdata + (i/2)*L;
+		std::vector<double> const &coef(_coef[i]), &func(funcTables[i]);
+		int part(i%2);
+		for(int m = 0; m < L; ++m) {
+			gdata[m][part] = coef[m]*func[m];
+		}
+		if(i == nell-1 && part == 0) {
+			for(int m = 0; m < L; ++m) gdata[m][1] = 0;
+		}
+	}
+	// Calculate the Fourier transforms of all pairs
+	FFTW(execute)(_pimpl->gplan);
+	// Multiply by the transformed kernels (see the constructor), saving the results in gdata
+	for(int pair = 0; pair < npair; ++pair) {
+		FFTW(complex) *gdata = _pimpl->gdata + pair*L;
+		FFTW(complex) const *pdata = _pimpl->fdata + pair*L, *qdata = _pimpl->hdata + pair*L;
+		for(int m = 0; m <= L/2; ++m) {
+			int mc = (L - m)%L;
+			double zre(gdata[m][0]), zim(gdata[m][1]), zcre(gdata[mc][0]), zcim(gdata[mc][1]);
+			gdata[m][0] = zre*pdata[m][0] - zim*pdata[m][1] + zcre*qdata[m][0] + zcim*qdata[m][1];
+			gdata[m][1] = zre*pdata[m][1] + zim*pdata[m][0] + zcre*qdata[m][1] - zcim*qdata[m][0];
+			if(mc == m) continue;
+			gdata[mc][0] = zcre*pdata[mc][0] - zcim*pdata[mc][1] + zre*qdata[mc][0] + zim*qdata[mc][1];
+			gdata[mc][1] = zcre*pdata[mc][1] + zcim*pdata[mc][0] + zre*qdata[mc][1] - zim*qdata[mc][0];
+		}
+	}
+	// Calculate the inverse Fourier transforms that give the packed convolutions
+	FFTW(execute)(_pimpl->fgplan);
+	// Unpack, rescale and copy the results back to the vectors provided.
+	for(int i = 0; i < nell; ++i) {
+		FFTW(complex) *gdata = _pimpl->gdata + (i/2)*L;
+		std::vector<double> const &scale(_scale[i]);
+		std::vector<double> &result(results[i]);
+		int part(i%2);
+		for(int m = 0; m < nv; ++m) {
+			result[m] = scale[m]*gdata[m + _cleanBegin][part];
+		}
+	}
+#endif
+}
@@ -0,0 +1,73 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_BATCH_MULTIPOLE_TRANSFORM
+#define COSMO_BATCH_MULTIPOLE_TRANSFORM
+
+#include "cosmo/MultipoleTransform.h"
+
+#include "boost/smart_ptr.hpp"
+
+#include <vector>
+
+namespace cosmo {
+	class BatchMultipoleTransform {
+	// Calculates MultipoleTransform-style transforms for several multipoles at once
+	// using a single u grid shared by all multipoles. The kernel for each multipole
+	// is tabulated on a common log-spaced grid (using the smallest sample spacing
+	// required by any multipole) and all of the FFT convolutions are performed in one
+	// batched pass. Since the inputs and kernels are real, multipoles are packed in
+	// pairs into the real and imaginary parts of each complex FFT, so a batch of n
+	// multipoles needs (n+1)/2 forward and inverse FFTs instead of n. This allows a
+	// caller to tabulate all of its input functions at the same u values, but the
+	// common grid is usually larger than the grid each multipole would use alone.
+	public:
+		// Creates a new batch transform for the specified multipoles. Each multipole
+		// has its own veps value with the same meaning as in MultipoleTransform, and
+		// the remaining parameters also have the same meanings.
+		BatchMultipoleTransform(MultipoleTransform::Type type, std::vector<int> const &ells,
+			double vmin, double vmax, std::vector<double> const &veps,
+			MultipoleTransform::Strategy strategy, int minSamplesPerCycle = 2,
+			int minSamplesPerDecade = 40, int interpolationPadding = 3);
+		virtual ~BatchMultipoleTransform();
+		// Returns the number of multipoles in this batch.
+		int getNumMultipoles() const;
+		// Returns the multipole number of the specified batch index.
+		int getEll(int index) const;
+		// Returns the number of points used for each FFT convolution.
+		int getFftSize() const;
+		// Returns the grid of u values where each function to be transformed should be
+		// evaluated. The values in u grid are always strictly decreasing (!) and positive.
+		std::vector<double> const &getUGrid() const;
+		// Returns the grid of v values where our transformed results will be estimated.
+		// This grid is free of convolution aliasing for every multipole, and extends
+		// beyond [vmin,vmax] by at least interpolationPadding points on each side.
+		std::vector<double> const &getVGrid() const;
+		// Estimates the transforms of each function on our v grid using the specified
+		// values tabulated on our u grid, with funcTables[i] corresponding to getEll(i).
+		// The results are saved in the vectors provided, which will be resized if necessary.
+		void transform(std::vector<std::vector<double> > const &funcTables,
+			std::vector<std::vector<double> > &results) const;
+	private:
+		std::vector<int> _ells;
+		int _Ntot, _cleanBegin, _cleanEnd;
+		std::vector<double> _ugrid, _vgrid;
+		std::vector<std::vector<double> > _coef, _scale;
+		// We use an implementation subclass to avoid any public include dependency
+		// on fftw, since this is an optional package when building our library.
+		class Implementation;
+		boost::scoped_ptr<Implementation> _pimpl;
+	}; // BatchMultipoleTransform
+
+	inline int BatchMultipoleTransform::getNumMultipoles() const { return _ells.size(); }
+	inline int BatchMultipoleTransform::getEll(int index) const { return _ells[index]; }
+	inline int BatchMultipoleTransform::getFftSize() const { return 2*_Ntot; }
+	inline std::vector<double> const &BatchMultipoleTransform::getUGrid() const {
+		return _ugrid;
+	}
+	inline std::vector<double> const &BatchMultipoleTransform::getVGrid() const {
+		return _vgrid;
+	}
+
+} // cosmo
+
+#endif // COSMO_BATCH_MULTIPOLE_TRANSFORM
@@ -0,0 +1,65 @@
+// Created 18-Oct-2026
+
+#include "cosmo/BinnedCorrelationProjector.h"
+#include "cosmo/TransferFunctionPowerSpectrum.h"
+#include "cosmo/RuntimeError.h"
+
+#include "likely/BinnedGrid.h"
+#include "likely/AbsBinning.h"
+
+#include <cmath>
+
+namespace local = cosmo;
+
+local::BinnedCorrelationProjector::BinnedCorrelationProjector(DistortedPowerCorrelation const &dpc,
+likely::BinnedGrid const &grid, bool rmu, int nsub, bool volumeWeighted)
+: CorrelationProjector(dpc)
+{
+	if(grid.getNAxes() != 2) {
+		throw RuntimeError("BinnedCorrelationProjector: expected a 2D grid.");
+	}
+	if(nsub < 1) {
+		throw RuntimeError("BinnedCorrelationProjector: expected nsub >= 1.");
+	}
+	likely::AbsBinningCPtr axis1(grid.getAxisBinning(0)), axis2(grid.getAxisBinning(1));
+	// Tabulate a Gauss-Legendre rule on [0,1]
+	std::vector<double> nodes, weights;
+	getGaussLegendreRule(nsub,nodes,weights,0,1);
+	int nbins(grid.getNBinsTotal());
+	std::vector<int> binIndices;
+	std::vector<double> r(nsub*nsub), mu(nsub*nsub), wgt(nsub*nsub);
+	for(int index = 0; index < nbins; ++index) {
+		grid.getBinIndices(index,binIndices);
+		double lo1(axis1->getBinLowEdge(binIndices[0])), hi1(axis1->getBinHighEdge(binIndices[0]));
+		double lo2(axis2->getBinLowEdge(binIndices[1])), hi2(axis2->getBinHighEdge(binIndices[1]));
+		// Calculate the sample points and their weights within this bin
+		double wsum(0);
+		for(int i = 0; i < nsub; ++i) {
+			double x1 = lo1 + (hi1-lo1)*nodes[i];
+			for(int j = 0; j < nsub; ++j) {
+				double x2 = lo2 + (hi2-lo2)*nodes[j];
+				int k(i*nsub+j);
+				double w = weights[i]*weights[j];
+				if(rmu) {
+					r[k] = x1;
+					mu[k] = x2;
+					if(volumeWeighted) w *= x1*x1;
+				}
+				else {
+					r[k] = std::sqrt(x1*x1 + x2*x2);
+					mu[k] = r[k] > 0 ? x1/r[k] : 0;
+					if(volumeWeighted) w *= x2;
+				}
+				wgt[k] = w;
+				wsum += w;
+			}
+		}
+		if(wsum <= 0) {
+			throw RuntimeError("BinnedCorrelationProjector: bin has zero volume.");
+		}
+		for(int k = 0; k < nsub*nsub; ++k) _addPoint(index,r[k],mu[k],wgt[k]/wsum);
+	}
+	_finalize(nbins);
+}
+
+local::BinnedCorrelationProjector::~BinnedCorrelationProjector() { }
@@ -0,0 +1,32 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_BINNED_CORRELATION_PROJECTOR
+#define COSMO_BINNED_CORRELATION_PROJECTOR
+
+#include "cosmo/CorrelationProjector.h"
+
+namespace likely { class BinnedGrid; }
+
+namespace cosmo {
+	class BinnedCorrelationProjector : public CorrelationProjector {
+	// Represents a fixed linear map from the tabulated correlation multipoles of a
+	// DistortedPowerCorrelation to the average of xi(r,mu) over each bin of a 2D grid.
+	// The bin averages are calculated once, when the projector is created, using an
+	// nsub x nsub Gauss-Legendre rule in each bin, and then combined into a single
+	// sparse matrix so that each subsequent evaluation costs one sparse matrix-vector
+	// product, independent of nsub.
+	public:
+		// Creates a projector for averaging the correlation function dpc over each bin of
+		// the grid provided. The grid axes are (r,mu) if rmu is true, or else (r_par,r_perp).
+		// Averages are weighted by the 3D volume element (r^2 dr dmu or r_perp dr_par dr_perp)
+		// if volumeWeighted is true, or else uniformly in the grid coordinates. Bins must lie
+		// inside the r range of the correlation function.
+		BinnedCorrelationProjector(DistortedPowerCorrelation const &dpc,
+			likely::BinnedGrid const &grid, bool rmu = true, int nsub = 5,
+			bool volumeWeighted = true);
+		virtual ~BinnedCorrelationProjector();
+	private:
+	}; // BinnedCorrelationProjector
+} // cosmo
+
+#endif // COSMO_BINNED_CORRELATION_PROJECTOR
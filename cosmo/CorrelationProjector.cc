@@ -0,0 +1,126 @@
+// Created 18-Oct-2026
+
+#include "cosmo/CorrelationProjector.h"
+#include "cosmo/DistortedPowerCorrelation.h"
+#include "cosmo/TransferFunctionPowerSpectrum.h"
+#include "cosmo/RuntimeError.h"
+
+#include <algorithm>
+
+namespace local = cosmo;
+
+local::CorrelationProjector::CorrelationProjector(DistortedPowerCorrelation const &dpc)
+: _rgrid(dpc.getRGrid()), _ellMax(dpc.getEllMax()), _symmetric(dpc.isSymmetric()), _rowStart(1,0)
+{ }
+
+local::CorrelationProjector::CorrelationProjector(DistortedPowerCorrelation const &dpc,
+std::vector<double> const &r, std::vector<double> const &mu)
+: _rgrid(dpc.getRGrid()), _ellMax(dpc.getEllMax()), _symmetric(dpc.isSymmetric()), _rowStart(1,0)
+{
+	int npoints(r.size());
+	if(mu.size() != npoints) {
+		throw RuntimeError("CorrelationProjector: r and mu have different sizes.");
+	}
+	for(int i = 0; i < npoints; ++i) _addPoint(i,r[i],mu[i]);
+	_finalize(npoints);
+}
+
+local::CorrelationProjector::~CorrelationProjector() { }
+
+void local::CorrelationProjector::_addPoint(int row, double r, double mu, double weight) {
+	if(r < _rgrid.front() || r > _rgrid.back()) {
+		throw RuntimeError("CorrelationProjector: r out of range.");
+	}
+	if(mu < -1 || mu > 1) {
+		throw RuntimeError("CorrelationProjector: expected -1 <= mu <= 1.");
+	}
+	// Find the spline segment [j,j+1] containing r
+	int nr(_rgrid.size());
+	int j = std::upper_bound(_rgrid.begin(),_rgrid.end(),r) - _rgrid.begin() - 1;
+	if(j > nr-2) j = nr-2;
+	// Calculate the natural cubic spline weights of the tabulated values and second
+	// derivatives at each end of this segment.
+	double h(_rgrid[j+1]-_rgrid[j]);
+	double b((r-_rgrid[j])/h), a(1-b);
+	double h2(h*h/6);
+	double splineWeight[4] = { a, b, (a*a*a-a)*h2, (b*b*b-b)*h2 };
+	int offset[4] = { j, j+1, nr+j, nr+j+1 };
+	// Add the elements for each multipole
+	int dell = _symmetric ? 2 : 1;
+	for(int ell = 0; ell <= _ellMax; ell += dell) {
+		int base = 2*(ell/dell)*nr;
+		double lweight = weight*legendreP(ell,mu);
+		for(int k = 0; k < 4; ++k) {
+			_addRow.push_back(row);
+			_addCol.push_back(base + offset[k]);
+			_addWeight.push_back(lweight*splineWeight[k]);
+		}
+	}
+}
+
+namespace cosmo {
+	// Orders accumulated elements by row then column.
+	struct ProjectorElementOrder {
+		ProjectorElementOrder(std::vector<int> const &row, std::vector<int> const &col)
+		: _row(row), _col(col) { }
+		bool operator()(int i, int j) const {
+			return _row[i] < _row[j] || (_row[i] == _row[j] && _col[i] < _col[j]);
+		}
+		std::vector<int> const &_row, &_col;
+	};
+} // cosmo::
+
+void local::CorrelationProjector::_finalize(int nrows) {
+	int nadd(_addRow.size());
+	std::vector<int> order(nadd);
+	for(int i = 0; i < nadd; ++i) order[i] = i;
+	std::sort(order.begin(),order.end(),ProjectorElementOrder(_addRow,_addCol));
+	// Pack into compressed sparse row format, combining duplicate elements
+	_rowStart.assign(nrows+1,0);
+	_column.clear();
+	_weight.clear();
+	int lastRow(-1), lastCol(-1);
+	for(int k = 0; k < nadd; ++k) {
+		int i(order[k]), row(_addRow[i]), col(_addCol[i]);
+		if(row < 0 || row >= nrows) {
+			throw RuntimeError("CorrelationProjector: invalid row.");
+		}
+		if(row == lastRow && col == lastCol) {
+			_weight.back() += _addWeight[i];
+			continue;
+		}
+		_column.push_back(col);
+		_weight.push_back(_addWeight[i]);
+		_rowStart[row+1]++;
+		lastRow = row;
+		lastCol = col;
+	}
+	for(int row = 0; row < nrows; ++row) _rowStart[row+1] += _rowStart[row];
+	// Release the accumulated elements
+	std::vector<int>().swap(_addRow);
+	std::vector<int>().swap(_addCol);
+	std::vector<double>().swap(_addWeight);
+}
+
+bool local::CorrelationProjector::isCompatible(std::vector<double> const &rgrid,
+int ellMax, bool symmetric) const {
+	return ellMax == _ellMax && symmetric == _symmetric && rgrid == _rgrid;
+}
+
+void local::CorrelationProjector::project(std::vector<double> const &coefs,
+std::vector<double> &result) const {
+	int dell = _symmetric ? 2 : 1;
+	if(coefs.size() != 2*(1+_ellMax/dell)*_rgrid.size()) {
+		throw RuntimeError("CorrelationProjector::project: coefficients have unexpected size.");
+	}
+	int nrows(getNumPoints());
+	if(result.size() != nrows) std::vector<double>(nrows).swap(result);
+	double const *coef = &coefs[0];
+	for(int row = 0; row < nrows; ++row) {
+		double sum(0);
+		for(int k = _rowStart[row]; k < _rowStart[row+1]; ++k) {
+			sum += _weight[k]*coef[_column[k]];
+		}
+		result[row] = sum;
+	}
+}
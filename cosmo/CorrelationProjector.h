@@ -0,0 +1,59 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_CORRELATION_PROJECTOR
+#define COSMO_CORRELATION_PROJECTOR
+
+#include <vector>
+
+namespace cosmo {
+	class DistortedPowerCorrelation;
+	class CorrelationProjector {
+	// Represents a fixed linear map from the tabulated correlation multipoles of a
+	// DistortedPowerCorrelation to the values of xi(r,mu) at a fixed set of points.
+	// Spline segment lookups and Legendre weights are calculated once, when the projector
+	// is created, so that each subsequent evaluation is a sparse matrix-vector product
+	// with 4 non-zero elements per multipole per point. The projector only depends on the
+	// r grid and multipoles of the correlation function used to create it, so remains
+	// valid after the correlation function is re-transformed.
+	public:
+		// Creates a projector for evaluating the correlation function dpc at each (r[i],mu[i]).
+		CorrelationProjector(DistortedPowerCorrelation const &dpc,
+			std::vector<double> const &r, std::vector<double> const &mu);
+		virtual ~CorrelationProjector();
+		// Returns the number of points that this projector evaluates.
+		int getNumPoints() const;
+		// Returns the number of non-zero elements in our projection matrix.
+		int getNumNonZero() const;
+		// Tests if this projector was created for multipoles up to ellMax (with the
+		// specified symmetry) tabulated on exactly the r grid provided.
+		bool isCompatible(std::vector<double> const &rgrid, int ellMax, bool symmetric) const;
+		// Fills the vector provided with the result of applying our projection matrix to
+		// the stacked spline coefficients provided. This method is normally called via
+		// DistortedPowerCorrelation::getCorrelation(), which checks that the coefficients
+		// are for a compatible r grid and multipoles.
+		void project(std::vector<double> const &coefs, std::vector<double> &result) const;
+	protected:
+		// Creates an empty projector that subclasses fill using _addPoint() and _finalize().
+		explicit CorrelationProjector(DistortedPowerCorrelation const &dpc);
+		// Adds weight*xi(r,mu) to the specified output row.
+		void _addPoint(int row, double r, double mu, double weight = 1);
+		// Packs the accumulated elements for the specified number of rows.
+		void _finalize(int nrows);
+	private:
+		std::vector<double> _rgrid;
+		int _ellMax;
+		bool _symmetric;
+		// Elements accumulated by _addPoint
+		std::vector<int> _addRow, _addCol;
+		std::vector<double> _addWeight;
+		// Projection matrix in compressed sparse row format
+		std::vector<int> _rowStart, _column;
+		std::vector<double> _weight;
+	}; // CorrelationProjector
+
+	inline int CorrelationProjector::getNumPoints() const { return _rowStart.size()-1; }
+	inline int CorrelationProjector::getNumNonZero() const { return _weight.size(); }
+
+} // cosmo
+
+#endif // COSMO_CORRELATION_PROJECTOR
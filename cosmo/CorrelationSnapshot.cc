@@ -0,0 +1,114 @@
+// Created 18-Oct-2026
+
+#include "cosmo/CorrelationSnapshot.h"
+#include "cosmo/CorrelationProjector.h"
+#include "cosmo/NaturalSpline.h"
+#include "cosmo/TransferFunctionPowerSpectrum.h"
+#include "cosmo/RuntimeError.h"
+
+#include <algorithm>
+
+namespace local = cosmo;
+
+local::CorrelationSnapshot::CorrelationSnapshot(std::vector<double> const &rgrid,
+std::vector<std::vector<double> > const &xi, int ellMax, bool symmetric)
+: _rgrid(rgrid), _ellMax(ellMax), _symmetric(symmetric)
+{
+	int nr(rgrid.size()), nell(xi.size());
+	if(nr < 2) {
+		throw RuntimeError("CorrelationSnapshot: expected nr >= 2.");
+	}
+	if(nell != 1+ellMax/(symmetric ? 2 : 1)) {
+		throw RuntimeError("CorrelationSnapshot: unexpected number of multipoles.");
+	}
+	// Calculate the second derivatives of a natural cubic spline through each tabulated
+	// multipole, which (together with the tabulated values) determine the same
+	// interpolating function as a likely::Interpolator using "cspline".
+	std::vector<double>(2*nell*nr).swap(_splineCoefs);
+	std::vector<double> diag(nr), upper(nr);
+	factorNaturalSpline(nr,&rgrid[0],&diag[0],&upper[0]);
+	for(int idx = 0; idx < nell; ++idx) {
+		std::vector<double> const &y = xi[idx];
+		if(y.size() != nr) {
+			throw RuntimeError("CorrelationSnapshot: multipole has unexpected size.");
+		}
+		double *values = &_splineCoefs[2*idx*nr], *curv = values + nr;
+		std::copy(y.begin(),y.end(),values);
+		solveNaturalSpline(nr,&rgrid[0],&diag[0],&upper[0],values,curv);
+	}
+}
+
+local::CorrelationSnapshot::CorrelationSnapshot(std::vector<CorrelationSnapshotCPtr> const &snapshots,
+std::vector<double> const &coefs)
+{
+	int nterms(snapshots.size());
+	if(nterms == 0) {
+		throw RuntimeError("CorrelationSnapshot: expected at least one snapshot to combine.");
+	}
+	if(coefs.size() != nterms) {
+		throw RuntimeError("CorrelationSnapshot: wrong number of coefficients.");
+	}
+	CorrelationSnapshot const &first = *snapshots[0];
+	_rgrid = first._rgrid;
+	_ellMax = first._ellMax;
+	_symmetric = first._symmetric;
+	for(int i = 1; i < nterms; ++i) {
+		CorrelationSnapshot const &other = *snapshots[i];
+		if(other._ellMax != _ellMax || other._symmetric != _symmetric || other._rgrid != _rgrid) {
+			throw RuntimeError("CorrelationSnapshot: snapshots to combine are not compatible.");
+		}
+	}
+	int ncoefs(first._splineCoefs.size());
+	std::vector<double>(ncoefs,0.).swap(_splineCoefs);
+	for(int i = 0; i < nterms; ++i) {
+		double coef(coefs[i]);
+		double const *src = &snapshots[i]->_splineCoefs[0];
+		for(int j = 0; j < ncoefs; ++j) _splineCoefs[j] += coef*src[j];
+	}
+}
+
+local::CorrelationSnapshot::~CorrelationSnapshot() { }
+
+double local::CorrelationSnapshot::_evaluate(int idx, double r) const {
+	// Find the spline segment [j,j+1] containing r
+	int nr(_rgrid.size());
+	int j = std::upper_bound(_rgrid.begin(),_rgrid.end(),r) - _rgrid.begin() - 1;
+	if(j > nr-2) j = nr-2;
+	double h(_rgrid[j+1]-_rgrid[j]);
+	double b((r-_rgrid[j])/h), a(1-b);
+	double const *values = &_splineCoefs[2*idx*nr], *curv = values + nr;
+	return a*values[j] + b*values[j+1] + ((a*a*a-a)*curv[j] + (b*b*b-b)*curv[j+1])*h*h/6;
+}
+
+double local::CorrelationSnapshot::getCorrelationMultipole(double r, int ell) const {
+	if(ell < 0 || ell > _ellMax || (_symmetric && (ell%2))) {
+		throw RuntimeError("CorrelationSnapshot::getCorrelationMultipole: invalid ell.");
+	}
+	if(r < _rgrid.front() || r > _rgrid.back()) {
+		throw RuntimeError("CorrelationSnapshot::getCorrelationMultipole: r out of range.");
+	}
+	return _evaluate(_symmetric ? ell/2 : ell,r);
+}
+
+double local::CorrelationSnapshot::getCorrelation(double r, double mu) const {
+	if(mu < -1 || mu > 1) {
+		throw RuntimeError("CorrelationSnapshot::getCorrelation: expected -1 <= mu <= 1.");
+	}
+	if(r < _rgrid.front() || r > _rgrid.back()) {
+		throw RuntimeError("CorrelationSnapshot::getCorrelation: r out of range.");
+	}
+	double result(0);
+	int dell = _symmetric ? 2 : 1;
+	for(int ell = 0; ell <= _ellMax; ell += dell) {
+		result += _evaluate(ell/dell,r)*legendreP(ell,mu);
+	}
+	return result;
+}
+
+void local::CorrelationSnapshot::getCorrelation(CorrelationProjector const &projector,
+std::vector<double> &xi) const {
+	if(!projector.isCompatible(_rgrid,_ellMax,_symmetric)) {
+		throw RuntimeError("CorrelationSnapshot::getCorrelation: incompatible projector.");
+	}
+	projector.project(_splineCoefs,xi);
+}
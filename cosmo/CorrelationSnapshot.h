@@ -0,0 +1,64 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_CORRELATION_SNAPSHOT
+#define COSMO_CORRELATION_SNAPSHOT
+
+#include "cosmo/types.h"
+
+#include <vector>
+
+namespace cosmo {
+	class CorrelationProjector;
+	class CorrelationSnapshot {
+	// Represents an immutable set of correlation multipoles xi_ell(r) tabulated on a
+	// fixed r grid and interpolated with natural cubic splines. A DistortedPowerCorrelation
+	// publishes a new snapshot after each transform, so that a snapshot obtained on one
+	// thread remains valid and unchanged while the correlation function is re-transformed
+	// on another thread. All methods are const and use no shared mutable state (unlike
+	// a likely::Interpolator), so a single snapshot can be evaluated concurrently.
+	public:
+		// Creates a new snapshot of the multipoles xi[idx] tabulated on rgrid, where
+		// idx = ell/2 when symmetric and idx = ell otherwise.
+		CorrelationSnapshot(std::vector<double> const &rgrid,
+			std::vector<std::vector<double> > const &xi, int ellMax, bool symmetric);
+		// Creates a new snapshot whose multipoles are the linear combination
+		// Sum_i coefs[i]*xi_i of the snapshots provided, which must all use the same r grid
+		// and multipoles. The spline coefficients are linear in the tabulated values, so they
+		// are combined directly without solving for any new splines.
+		CorrelationSnapshot(std::vector<CorrelationSnapshotCPtr> const &snapshots,
+			std::vector<double> const &coefs);
+		virtual ~CorrelationSnapshot();
+		// Returns the specified multipole of xi(r,mu) evaluated at r.
+		double getCorrelationMultipole(double r, int ell) const;
+		// Returns the correlation function xi(r,mu).
+		double getCorrelation(double r, double mu) const;
+		// Fills the vector provided with xi(r,mu) evaluated at each point of the projector
+		// provided, which must have been created for the same r grid and multipoles (or
+		// else a RuntimeError is thrown).
+		void getCorrelation(CorrelationProjector const &projector, std::vector<double> &xi) const;
+		// Returns the grid of r values where our multipoles are tabulated.
+		std::vector<double> const &getRGrid() const;
+		// Returns the stacked tabulated values and spline second derivatives of each
+		// multipole, in the layout expected by CorrelationProjector::project().
+		std::vector<double> const &getSplineCoefficients() const;
+		// Returns the maximum multipole used.
+		int getEllMax() const;
+		// Tests if only even multipoles are used.
+		bool isSymmetric() const;
+	private:
+		std::vector<double> _rgrid, _splineCoefs;
+		int _ellMax;
+		bool _symmetric;
+		double _evaluate(int idx, double r) const;
+	}; // CorrelationSnapshot
+
+	inline std::vector<double> const &CorrelationSnapshot::getRGrid() const { return _rgrid; }
+	inline std::vector<double> const &CorrelationSnapshot::getSplineCoefficients() const {
+		return _splineCoefs;
+	}
+	inline int CorrelationSnapshot::getEllMax() const { return _ellMax; }
+	inline bool CorrelationSnapshot::isSymmetric() const { return _symmetric; }
+
+} // cosmo
+
+#endif // COSMO_CORRELATION_SNAPSHOT
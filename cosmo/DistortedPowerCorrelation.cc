@@ -3,10 +3,13 @@
 #include "cosmo/DistortedPowerCorrelation.h"
 #include "cosmo/TabulatedPower.h"
 #include "cosmo/AdaptiveMultipoleTransform.h"
+#include "cosmo/BatchMultipoleTransform.h"
+#include "cosmo/NaturalSpline.h"
+#include "cosmo/CorrelationProjector.h"
+#include "cosmo/CorrelationSnapshot.h"
 #include "cosmo/TransferFunctionPowerSpectrum.h"
 #include "cosmo/RuntimeError.h"
-
-#include "likely/Interpolator.h"
+#include "cosmo/Instrumentation.h"
 
 #include "boost/foreach.hpp"
 #include "boost/bind.hpp"
@@ -14,24 +17,30 @@
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <string>
 
 namespace local = cosmo;
 
+namespace cosmo {
+	// Returns the coefficient that transforms the k-space multipole P_ell(k) to xi_ell(r).
+	// The coefficient for odd ell includes a factor of i, which combines with the i of
+	// the odd multipoles of P(k,mu_k) (see the class description) to give a real result.
+	inline double getTransformCoefficient(int ell) {
+		double coef = multipoleTransformNormalization(ell,3,+1);
+		return (ell % 2) ? -coef : coef;
+	}
+} // cosmo::
+
 local::DistortedPowerCorrelation::DistortedPowerCorrelation(likely::GenericFunctionPtr power,
 RMuFunctionCPtr distortion, double klo, double khi, int nk, double rmin, double rmax, int nr,
-int ellMax, bool symmetric, double relerr, double abserr, double abspow)
+int ellMax, bool symmetric, double relerr, double abserr, double abspow, int nmuQuadrature)
 : _power(power), _distortion(distortion), _ellMax(ellMax), _symmetric(symmetric),
-_relerr(relerr), _abserr(abserr), _abspow(abspow), _initialized(false)
+_relerr(relerr), _abserr(abserr), _abspow(abspow), _initialized(false),
+_parallel(true), _optimize(false),
+_verifyPolicy(AdaptiveMultipoleTransform::AlwaysVerify), _verifyPeriod(1), _verifyMaxDrift(0),
+_batchSinceVerified(-1), _batchLastAccurate(true)
 {	
-	if(khi <= klo) {
-		throw RuntimeError("DistortedPowerCorrelation: expected klo < khi.");
-	}
-	if(klo <= 0) {
-		throw RuntimeError("DistortedPowerCorrelation: expected klo > 0.");
-	}
-	if(nk < 2) {
-		throw RuntimeError("DistortedPowerCorrelation: expected nk >= 2.");
-	}
 	if(rmax <= rmin) {
 		throw RuntimeError("DistortedPowerCorrelation: expected rmin < rmax.");
 	}
@@ -41,12 +50,63 @@ _relerr(relerr), _abserr(abserr), _abspow(abspow), _initialized(false)
 	if(nr < 2) {
 		throw RuntimeError("DistortedPowerCorrelation: expected nr >= 2.");
 	}
-	if(ellMax < 0) {
+	// Initialize the r grid we will use for interpolation
+	_rgrid.reserve(nr);
+	double dr = (rmax - rmin)/(nr-1.);
+	for(int i = 0; i < nr; ++i) {
+		_rgrid.push_back(rmin + dr*i);
+	}
+	_setup(klo,khi,nk,nmuQuadrature);
+}
+
+local::DistortedPowerCorrelation::DistortedPowerCorrelation(likely::GenericFunctionPtr power,
+RMuFunctionCPtr distortion, double klo, double khi, int nk, std::vector<double> const &rgrid,
+int ellMax, bool symmetric, double relerr, double abserr, double abspow, int nmuQuadrature)
+: _power(power), _distortion(distortion), _ellMax(ellMax), _symmetric(symmetric),
+_relerr(relerr), _abserr(abserr), _abspow(abspow), _initialized(false),
+_parallel(true), _optimize(false),
+_verifyPolicy(AdaptiveMultipoleTransform::AlwaysVerify), _verifyPeriod(1), _verifyMaxDrift(0),
+_batchSinceVerified(-1), _batchLastAccurate(true)
+{
+	_checkRGrid(rgrid);
+	_rgrid = rgrid;
+	_setup(klo,khi,nk,nmuQuadrature);
+}
+
+void local::DistortedPowerCorrelation::_checkRGrid(std::vector<double> const &rgrid) const {
+	int nr(rgrid.size());
+	if(nr < 2) {
+		throw RuntimeError("DistortedPowerCorrelation: expected nr >= 2.");
+	}
+	if(rgrid[0] <= 0) {
+		throw RuntimeError("DistortedPowerCorrelation: expected rmin > 0.");
+	}
+	for(int i = 1; i < nr; ++i) {
+		if(rgrid[i] <= rgrid[i-1]) {
+			throw RuntimeError("DistortedPowerCorrelation: r grid is not increasing.");
+		}
+	}
+}
+
+void local::DistortedPowerCorrelation::_setup(double klo, double khi, int nk, int nmuQuadrature) {
+	if(khi <= klo) {
+		throw RuntimeError("DistortedPowerCorrelation: expected klo < khi.");
+	}
+	if(klo <= 0) {
+		throw RuntimeError("DistortedPowerCorrelation: expected klo > 0.");
+	}
+	if(nk < 2) {
+		throw RuntimeError("DistortedPowerCorrelation: expected nk >= 2.");
+	}
+	if(_ellMax < 0) {
 		throw RuntimeError("DistortedPowerCorrelation: expected ellMax >= 0.");
 	}
-	if(symmetric && (ellMax%2 == 1)) {
+	if(_symmetric && (_ellMax%2 == 1)) {
 		throw RuntimeError("DistortedPowerCorrelation: expected even ellMax when symmetric.");
 	}
+	if(nmuQuadrature < 0) {
+		throw RuntimeError("DistortedPowerCorrelation: expected nmuQuadrature >= 0.");
+	}
 	// Initialize the k grid we will use for interpolation
 	_kgrid.reserve(nk);
 	double dk = std::pow(khi/klo,1./(nk-1.));
@@ -55,30 +115,38 @@ _relerr(relerr), _abserr(abserr), _abspow(abspow), _initialized(false)
 	}
 	// Calculate the min samples/decade corresponding to nk samples from klo to khi
 	_minSamplesPerDecade = (int)std::ceil(nk/std::log10(khi/klo));
-	// Initialize the r grid we will use for interpolation
-	_rgrid.reserve(nr);
-	double dr = (rmax - rmin)/(nr-1.);
-	for(int i = 0; i < nr; ++i) {
-		_rgrid.push_back(rmin + dr*i);
-	}
 	// create a transform object for each moment
-	int dell = symmetric ? 2 : 1;
-	int nell = 1+ellMax/dell;
+	int nr(_rgrid.size());
+	int dell = _symmetric ? 2 : 1;
+	int nell = 1+_ellMax/dell;
 	_transformer.reserve(nell);
 	_xiMoments.reserve(nell);
-	_interpolator.reserve(nell);
 	_savedPowerMultipole.reserve(nell);
-	for(int ell = 0; ell <= ellMax; ell += dell) {
-		double coef = multipoleTransformNormalization(ell,3,+1);
+	for(int ell = 0; ell <= _ellMax; ell += dell) {
+		double coef = getTransformCoefficient(ell);
 		// Use the same relerr for each ell and share abserr equally. These values will
 		// be adjusted when initialize is called later.
 		AdaptiveMultipoleTransformPtr amt(new AdaptiveMultipoleTransform(
-			MultipoleTransform::SphericalBessel,ell,coef,_rgrid,relerr/10.,abserr/(2*nell),abspow));
+			MultipoleTransform::SphericalBessel,ell,coef,_rgrid,_relerr/10.,_abserr/(2*nell),_abspow));
+		amt->setVerificationPolicy(_verifyPolicy,_verifyPeriod,_verifyMaxDrift);
 		_transformer.push_back(amt);
 		_xiMoments.push_back(std::vector<double>(nr,0.));
-		_interpolator.push_back(likely::InterpolatorPtr());
 		_savedPowerMultipole.push_back(cosmo::TabulatedPowerCPtr());
 	}
+	// Tabulate the Gauss-Legendre nodes and the matrix of weights that projects
+	// D(k,mu_j) onto each multipole, if requested.
+	if(nmuQuadrature > 0) {
+		std::vector<double> weights;
+		getGaussLegendreRule(nmuQuadrature,_muNodes,weights,_symmetric ? 0 : -1,1);
+		// Integrating over 0 < mu < 1 only covers half of the full range
+		double norm = _symmetric ? 1 : 0.5;
+		_legendreWeights.reserve(nell*nmuQuadrature);
+		for(int ell = 0; ell <= _ellMax; ell += dell) {
+			for(int j = 0; j < nmuQuadrature; ++j) {
+				_legendreWeights.push_back(norm*(2*ell+1)*weights[j]*legendreP(ell,_muNodes[j]));
+			}
+		}
+	}
 	// initialize vectors used to find biggest relative contributions
 	std::vector<double>(nell).swap(_rbig);
 	std::vector<double>(nell).swap(_mubig);
@@ -98,27 +166,98 @@ double local::DistortedPowerCorrelation::getPowerMultipole(double k, int ell) co
 	if(ell < 0 || ell > _ellMax || (_symmetric && (ell%2))) {
 		throw RuntimeError("DistortedPowerCorrelation::getPowerMultipole: invalid ell.");
 	}
-	// Do mu integral of D(k,mu) with fixed k, then multiply result by P(k)
+	return (*_power)(k)*_getDistortionMultipole(k,ell);
+}
+
+double local::DistortedPowerCorrelation::_getDistortionMultipole(double k, int ell) const {
+	int nmu(_muNodes.size());
+	if(nmu > 0) {
+		// Use our fixed quadrature rule
+		int dell = _symmetric ? 2 : 1;
+		double const *weight = &_legendreWeights[(ell/dell)*nmu];
+		double result(0);
+		for(int j = 0; j < nmu; ++j) {
+			result += weight[j]*(*_distortion)(k,_muNodes[j]);
+		}
+		return result;
+	}
+	// Do mu integral of D(k,mu) with fixed k
 	likely::GenericFunctionPtr fOfMuPtr(
 		new likely::GenericFunction(boost::bind(*_distortion,k,_1)));
-	return (*_power)(k)*getMultipole(fOfMuPtr, ell);
+	double epsAbs(1e-6), epsRel(1e-6);
+	return getMultipole(fOfMuPtr, ell, epsAbs, epsRel, _symmetric);
 }
 
 void local::DistortedPowerCorrelation::_initPowerMultipoles() const {
-	// initialize a vector of multipoles
-	int nk(_kgrid.size());
-	std::vector<double> pgrid(nk);
-	// loop over multipoles
+	COSMO_TIME(PowerMultipoleTime);
+	std::vector<std::vector<double> > pgrid;
+	_tabulatePowerMultipoles(_kgrid,pgrid);
+	// create and save a new tabulated power for each multipole
+	for(int idx = 0; idx < pgrid.size(); ++idx) {
+		_savedPowerMultipole[idx].reset(new cosmo::TabulatedPower(_kgrid,pgrid[idx],true,true));
+	}
+}
+
+void local::DistortedPowerCorrelation::_tabulatePowerMultipoles(std::vector<double> const &kgrid,
+std::vector<std::vector<double> > &pgrid) const {
+	int nk(kgrid.size());
 	int dell = _symmetric ? 2 : 1;
-	for(int ell = 0; ell <= _ellMax; ell += dell) {
-		// loop over k values
+	int nell = 1+_ellMax/dell;
+	// Tabulate P(k) serially since the power function is not necessarily thread safe
+	// (e.g., interpolators with a lookup accelerator).
+	std::vector<double> pk(nk);
+	for(int i = 0; i < nk; ++i) {
+		pk[i] = (*_power)(kgrid[i]);
+	}
+	if(pgrid.size() != nell) pgrid.resize(nell);
+	for(int idx = 0; idx < nell; ++idx) {
+		if(pgrid[idx].size() != nk) std::vector<double>(nk).swap(pgrid[idx]);
+	}
+	std::string error;
+	int nmu(_muNodes.size());
+	if(nmu > 0) {
+		// Evaluate D(k,mu_j) once per k at each quadrature node, in parallel. Exceptions
+		// cannot propagate out of a parallel loop, so we save the first message and rethrow.
+		std::vector<double> dgrid(nk*nmu);
+		#pragma omp parallel for schedule(dynamic,16) if(_parallel)
 		for(int i = 0; i < nk; ++i) {
-			pgrid[i] = getPowerMultipole(_kgrid[i],ell);
+			try {
+				for(int j = 0; j < nmu; ++j) {
+					dgrid[i*nmu+j] = (*_distortion)(kgrid[i],_muNodes[j]);
+				}
+			}
+			catch(std::exception const &e) {
+				#pragma omp critical (DistortedPowerCorrelation_error)
+				if(error.empty()) error = e.what();
+			}
 		}
-		// create and save a new tabulated power using this grid
-		cosmo::TabulatedPowerCPtr tpptr(new cosmo::TabulatedPower(_kgrid,pgrid,true,true));
-		int idx = _symmetric ? ell/2 : ell;
-		_savedPowerMultipole[idx] = tpptr;
+		if(!error.empty()) throw RuntimeError(error);
+		// Project onto all multipoles with the (nell,nmu) x (nmu,nk) product of our
+		// Legendre weight matrix and the tabulated D(k,mu_j) values.
+		for(int idx = 0; idx < nell; ++idx) {
+			double const *weight = &_legendreWeights[idx*nmu];
+			for(int i = 0; i < nk; ++i) {
+				double const *dval = &dgrid[i*nmu];
+				double sum(0);
+				for(int j = 0; j < nmu; ++j) sum += weight[j]*dval[j];
+				pgrid[idx][i] = pk[i]*sum;
+			}
+		}
+	}
+	else {
+		// Tabulate the multipole integrals of D(k,mu) for each (ell,k) in parallel.
+		#pragma omp parallel for schedule(dynamic,16) if(_parallel)
+		for(int task = 0; task < nell*nk; ++task) {
+			int idx(task/nk), i(task%nk);
+			try {
+				pgrid[idx][i] = pk[i]*_getDistortionMultipole(kgrid[i],idx*dell);
+			}
+			catch(std::exception const &e) {
+				#pragma omp critical (DistortedPowerCorrelation_error)
+				if(error.empty()) error = e.what();
+			}
+		}
+		if(!error.empty()) throw RuntimeError(error);
 	}
 }
 
@@ -133,37 +272,66 @@ double local::DistortedPowerCorrelation::getSavedPowerMultipole(double k, int el
 	return (*_savedPowerMultipole[idx])(k);
 }
 
+local::AdaptiveMultipoleTransform::LogGridFunctionPtr
+local::DistortedPowerCorrelation::_getSavedPowerMultipoleGrid(int ell) const {
+	int idx = _symmetric ? ell/2 : ell;
+	if(!_savedPowerMultipole[idx]) {
+		throw RuntimeError("DistortedPowerCorrelation::getSavedPowerMultipole: not initialized.");
+	}
+	AdaptiveMultipoleTransform::LogGridFunctionPtr fptr(
+		new AdaptiveMultipoleTransform::LogGridFunction(boost::bind(
+			&TabulatedPower::evaluateLogGrid,_savedPowerMultipole[idx],_1,_2,_3)));
+	return fptr;
+}
+
+local::CorrelationSnapshotCPtr local::DistortedPowerCorrelation::getSnapshot() const {
+	return boost::atomic_load(&_snapshot);
+}
+
+void local::DistortedPowerCorrelation::setVerificationPolicy(
+AdaptiveMultipoleTransform::VerificationPolicy policy, int period, double maxDrift) {
+	// Validate and apply to each of our transforms
+	for(int idx = 0; idx < _transformer.size(); ++idx) {
+		_transformer[idx]->setVerificationPolicy(policy,period,maxDrift);
+	}
+	_verifyPolicy = policy;
+	_verifyPeriod = period;
+	_verifyMaxDrift = maxDrift;
+	_batchSinceVerified = -1;
+}
+
+void local::DistortedPowerCorrelation::setParallel(bool parallel) {
+	_parallel = parallel;
+}
+
+bool local::DistortedPowerCorrelation::isParallel() const {
+	return _parallel;
+}
+
+void local::DistortedPowerCorrelation::_publishSnapshot() const {
+	COSMO_TIME(SnapshotTime);
+	CorrelationSnapshotCPtr snapshot(new CorrelationSnapshot(_rgrid,_xiMoments,_ellMax,_symmetric));
+	boost::atomic_store(&_snapshot,snapshot);
+}
+
 double local::DistortedPowerCorrelation::getCorrelationMultipole(double r, int ell) const {
-	if(!isInitialized()) {
+	CorrelationSnapshotCPtr snapshot(getSnapshot());
+	if(!snapshot) {
 		throw RuntimeError("DistortedPowerCorrelation::getCorrelationMultipole: not initialized.");
 	}
-	if(ell < 0 || ell > _ellMax || (_symmetric && (ell%2))) {
-		throw RuntimeError("DistortedPowerCorrelation::getCorrelationMultipole: invalid ell.");
-	}
-	if(r < _rgrid.front() || r > _rgrid.back()) {
-		throw RuntimeError("DistortedPowerCorrelation::getCorrelationMultipole: r out of range.");
-	}
-	int idx = _symmetric ? ell/2 : ell;
-	return (*_interpolator[idx])(r);
+	return snapshot->getCorrelationMultipole(r,ell);
 }
 
 double local::DistortedPowerCorrelation::getCorrelation(double r, double mu) const {
-	if(!isInitialized()) {
+	CorrelationSnapshotCPtr snapshot(getSnapshot());
+	if(!snapshot) {
 		throw RuntimeError("DistortedPowerCorrelation::getCorrelation: not initialized.");
 	}
-	if(mu < -1 || mu > 1) {
-		throw RuntimeError("DistortedPowerCorrelation::getPower: expected -1 <= mu <= 1.");
-	}
-	double result(0);
-	int dell = _symmetric ? 2 : 1;
-	for(int ell = 0; ell <= _ellMax; ell += dell) {
-		result += getCorrelationMultipole(r,ell)*legendreP(ell,mu);
-	}
-	return result;
+	return snapshot->getCorrelation(r,mu);
 }
 
 void local::DistortedPowerCorrelation::initialize(int nmu,
-double margin, double vepsMax, double vepsMin, bool optimize) {
+double margin, double vepsMax, double vepsMin, bool optimize, bool batch) {
 	if(nmu < 2) {
 		throw RuntimeError("DistortedPowerCorrelation::initialize: expected nmu >= 2.");
 	}
@@ -182,16 +350,12 @@ double margin, double vepsMax, double vepsMin, bool optimize) {
 	int dell = _symmetric ? 2 : 1;
 	for(int ell = 0; ell <= _ellMax; ell += dell) {
 		int idx(ell/dell);
-		// Build a function object that evaluates this multipole for arbitrary k
-		likely::GenericFunctionPtr fOfKPtr(
-			new likely::GenericFunction(boost::bind(
-				&DistortedPowerCorrelation::getSavedPowerMultipole,this,_1,ell)));
+		// Build a function object that evaluates this multipole on each transform's k grid
+		AdaptiveMultipoleTransform::LogGridFunctionPtr fOfKPtr = _getSavedPowerMultipoleGrid(ell);
 		// Do not optimize now
 		bool noOptimize(false);
 		_transformer[idx]->initialize(fOfKPtr,_xiMoments[idx],_minSamplesPerDecade,margin,
 			vepsMax,vepsMin,noOptimize);
-		// (re)create the interpolator for this moment
-		_interpolator[idx].reset(new likely::Interpolator(_rgrid,_xiMoments[idx],"cspline"));
 	}
 	// Loop over our (r,mu) evaluation grid.
 	double dmu = 2./dell/(nmu-1.);
@@ -199,14 +363,15 @@ double margin, double vepsMax, double vepsMin, bool optimize) {
 	std::vector<double> contribution(nell);
 	// Clear our relative errors
 	std::fill(_relbig.begin(),_relbig.end(),0.);
-	BOOST_FOREACH(double r, _rgrid) {
+	for(int ir = 0; ir < _rgrid.size(); ++ir) {
+		double r(_rgrid[ir]);
 		for(int i = 0; i < nmu; ++i) {
 			double mu = 1. - i*dmu;
 			// Loop over multipoles to calculate their relative contributions at (r,mu)
-			double xisum;
+			double xisum(0);
 			for(int ell = 0; ell <= _ellMax; ell += dell) {
 				int idx = _symmetric ? ell/2 : ell;
-				double term = (*_interpolator[idx])(r)*legendreP(ell,mu);
+				double term = _xiMoments[idx][ir]*legendreP(ell,mu);
 				contribution[idx] = term;
 				xisum += term;
 			}
@@ -229,21 +394,353 @@ double margin, double vepsMax, double vepsMin, bool optimize) {
 		// _relbig[idx] might be zero if all xi(r,mu) were ~0 on the grid
 		double relerr = _relbig[idx] > 0 ? _relerr/nell/_relbig[idx] : _relerr/nell;
 		double abserr = _abserr/nell;
-		double coef = multipoleTransformNormalization(ell,3,+1);
+		double coef = getTransformCoefficient(ell);
 		AdaptiveMultipoleTransformPtr amt(new AdaptiveMultipoleTransform(
 			MultipoleTransform::SphericalBessel,ell,coef,_rgrid,relerr,abserr,_abspow));
+		amt->setVerificationPolicy(_verifyPolicy,_verifyPeriod,_verifyMaxDrift);
 		_transformer[idx] = amt;
-		// Build a function object that evaluates this multipole for arbitrary k
-		likely::GenericFunctionPtr fOfKPtr(
-			new likely::GenericFunction(boost::bind(
-				&DistortedPowerCorrelation::getSavedPowerMultipole,this,_1,ell)));
+		// Build a function object that evaluates this multipole on each transform's k grid
+		AdaptiveMultipoleTransform::LogGridFunctionPtr fOfKPtr = _getSavedPowerMultipoleGrid(ell);
 		// Initialize our new transformer (with optimization, if requested)
 		_transformer[idx]->initialize(fOfKPtr,_xiMoments[idx],_minSamplesPerDecade,margin,
 			vepsMax,vepsMin,optimize);
-		// (re)create the interpolator for this moment
-		_interpolator[idx].reset(new likely::Interpolator(_rgrid,_xiMoments[idx],"cspline"));
 	}
+	// Build batch transforms using the veps value selected for each multipole, if requested
+	_optimize = optimize;
+	_initBatchTransforms(batch,optimize);
+	_publishSnapshot();
+	_initialized = true;
+}
+
+void local::DistortedPowerCorrelation::_initBatchTransforms(bool batch, bool optimize) {
+	_batchGood.reset();
+	_batchBetter.reset();
+	_batchResampleGood.reset();
+	_batchResampleBetter.reset();
+	_batchSinceVerified = -1;
+	if(!batch) return;
+	int dell = _symmetric ? 2 : 1;
+	std::vector<int> ells;
+	std::vector<double> veps;
+	for(int ell = 0; ell <= _ellMax; ell += dell) {
+		ells.push_back(ell);
+		veps.push_back(_transformer[ell/dell]->getVEps());
+	}
+	MultipoleTransform::Strategy strategy(optimize ?
+		MultipoleTransform::MeasurePlan : MultipoleTransform::EstimatePlan);
+	int minSamplesPerCycle(2);
+	_batchBetter.reset(new BatchMultipoleTransform(MultipoleTransform::SphericalBessel,
+		ells,_rgrid.front(),_rgrid.back(),veps,strategy,minSamplesPerCycle,_minSamplesPerDecade));
+	BOOST_FOREACH(double &v, veps) v *= 2;
+	_batchGood.reset(new BatchMultipoleTransform(MultipoleTransform::SphericalBessel,
+		ells,_rgrid.front(),_rgrid.back(),veps,strategy,minSamplesPerCycle,_minSamplesPerDecade));
+	// Precompute the interpolation from each batch's v grid to our r grid.
+	_batchResampleBetter.reset(new NaturalSplineResampler(_batchBetter->getVGrid(),_rgrid));
+	_batchResampleGood.reset(new NaturalSplineResampler(_batchGood->getVGrid(),_rgrid));
+}
+
+namespace cosmo {
+	// Helpers for reading and writing our binary state files.
+	namespace dpcio {
+		char const magic[8] = { 'C','O','S','M','O','D','P','C' };
+		int const version = 2;
+		template <class T> void write(std::ostream &out, T const &value) {
+			out.write(reinterpret_cast<char const*>(&value),sizeof(T));
+		}
+		template <class T> T read(std::istream &in) {
+			T value;
+			in.read(reinterpret_cast<char*>(&value),sizeof(T));
+			if(!in) throw RuntimeError("DistortedPowerCorrelation::restore: unexpected end of file.");
+			return value;
+		}
+		// Returns the number of unread bytes in a seekable input stream, so that sizes
+		// read from a corrupted file can be checked before we allocate anything.
+		std::streamoff remaining(std::istream &in) {
+			std::streampos pos = in.tellg();
+			in.seekg(0,std::ios::end);
+			std::streampos end = in.tellg();
+			in.seekg(pos);
+			if(!in || pos < 0 || end < pos) {
+				throw RuntimeError("DistortedPowerCorrelation::restore: unable to determine file size.");
+			}
+			return end - pos;
+		}
+		void writeString(std::ostream &out, std::string const &value) {
+			write<int>(out,value.size());
+			out.write(value.data(),value.size());
+		}
+		std::string readString(std::istream &in) {
+			int size = read<int>(in);
+			if(size < 0 || size > remaining(in)) {
+				throw RuntimeError("DistortedPowerCorrelation::restore: invalid string size.");
+			}
+			std::string value(size,' ');
+			if(size > 0) in.read(&value[0],size);
+			if(!in) throw RuntimeError("DistortedPowerCorrelation::restore: unexpected end of file.");
+			return value;
+		}
+	} // dpcio
+} // cosmo::
+
+void local::DistortedPowerCorrelation::save(std::string const &filename, bool saveWisdom) const {
+	if(!isInitialized()) {
+		throw RuntimeError("DistortedPowerCorrelation::save: not initialized.");
+	}
+	std::ofstream out(filename.c_str(),std::ios::binary);
+	if(!out) {
+		throw RuntimeError("DistortedPowerCorrelation::save: unable to open " + filename);
+	}
+	// Write a header and the configuration that the saved state depends on
+	out.write(dpcio::magic,sizeof(dpcio::magic));
+	dpcio::write<int>(out,dpcio::version);
+	dpcio::write<int>(out,_ellMax);
+	dpcio::write<int>(out,_symmetric ? 1 : 0);
+	dpcio::write<int>(out,_kgrid.size());
+	dpcio::write<double>(out,_kgrid.front());
+	dpcio::write<double>(out,_kgrid.back());
+	dpcio::write<double>(out,_relerr);
+	dpcio::write<double>(out,_abserr);
+	dpcio::write<double>(out,_abspow);
+	dpcio::write<int>(out,_muNodes.size());
+	// Write our r grid, which might have been changed by setRGrid()
+	dpcio::write<int>(out,_rgrid.size());
+	out.write(reinterpret_cast<char const*>(&_rgrid[0]),sizeof(double)*_rgrid.size());
+	// Write the tuned state of each multipole
+	for(int idx = 0; idx < _transformer.size(); ++idx) {
+		dpcio::write<double>(out,_transformer[idx]->getVEps());
+		dpcio::write<double>(out,_transformer[idx]->getRelErr());
+		dpcio::write<double>(out,_transformer[idx]->getAbsErr());
+		dpcio::write<double>(out,_rbig[idx]);
+		dpcio::write<double>(out,_mubig[idx]);
+		dpcio::write<double>(out,_relbig[idx]);
+	}
+	// Write optional FFTW planner wisdom
+	dpcio::writeString(out,saveWisdom ? exportTransformWisdom() : std::string());
+	if(!out) {
+		throw RuntimeError("DistortedPowerCorrelation::save: error writing to " + filename);
+	}
+}
+
+bool local::DistortedPowerCorrelation::restore(std::string const &filename,
+bool optimize, bool batch) {
+	std::ifstream in(filename.c_str(),std::ios::binary);
+	if(!in) {
+		throw RuntimeError("DistortedPowerCorrelation::restore: unable to open " + filename);
+	}
+	char magic[sizeof(dpcio::magic)];
+	in.read(magic,sizeof(magic));
+	if(!in || !std::equal(magic,magic+sizeof(magic),dpcio::magic)) {
+		throw RuntimeError("DistortedPowerCorrelation::restore: not a saved state file.");
+	}
+	if(dpcio::read<int>(in) != dpcio::version) {
+		throw RuntimeError("DistortedPowerCorrelation::restore: unsupported file version.");
+	}
+	// Check that the saved state was created with the same configuration as ours
+	bool match = (dpcio::read<int>(in) == _ellMax);
+	match &= (dpcio::read<int>(in) == (_symmetric ? 1 : 0));
+	match &= (dpcio::read<int>(in) == _kgrid.size());
+	match &= (dpcio::read<double>(in) == _kgrid.front());
+	match &= (dpcio::read<double>(in) == _kgrid.back());
+	match &= (dpcio::read<double>(in) == _relerr);
+	match &= (dpcio::read<double>(in) == _abserr);
+	match &= (dpcio::read<double>(in) == _abspow);
+	match &= (dpcio::read<int>(in) == _muNodes.size());
+	if(!match) {
+		throw RuntimeError("DistortedPowerCorrelation::restore: saved configuration does not match.");
+	}
+	// The saved r grid is part of the tuned state, but must cover our r range
+	int nr = dpcio::read<int>(in);
+	if(nr < 2 || nr > dpcio::remaining(in)/(std::streamoff)sizeof(double)) {
+		throw RuntimeError("DistortedPowerCorrelation::restore: invalid r grid size.");
+	}
+	std::vector<double> rgrid(nr);
+	in.read(reinterpret_cast<char*>(&rgrid[0]),sizeof(double)*nr);
+	if(!in) {
+		throw RuntimeError("DistortedPowerCorrelation::restore: unexpected end of file.");
+	}
+	_checkRGrid(rgrid);
+	if(rgrid.front() > _rgrid.front() || rgrid.back() < _rgrid.back()) {
+		throw RuntimeError("DistortedPowerCorrelation::restore: saved r grid does not cover our r range.");
+	}
+	// Read the tuned state of each multipole before changing anything
+	int nell(_transformer.size());
+	std::vector<double> veps(nell), relerr(nell), abserr(nell), rbig(nell), mubig(nell), relbig(nell);
+	for(int idx = 0; idx < nell; ++idx) {
+		veps[idx] = dpcio::read<double>(in);
+		relerr[idx] = dpcio::read<double>(in);
+		abserr[idx] = dpcio::read<double>(in);
+		rbig[idx] = dpcio::read<double>(in);
+		mubig[idx] = dpcio::read<double>(in);
+		relbig[idx] = dpcio::read<double>(in);
+	}
+	std::string wisdom = dpcio::readString(in);
+	if(!wisdom.empty()) importTransformWisdom(wisdom);
+	// Recreate our transformers without any veps search
+	_optimize = optimize;
+	_rgrid.swap(rgrid);
+	_restoreTransformers(veps,relerr,abserr);
+	_rbig.swap(rbig);
+	_mubig.swap(mubig);
+	_relbig.swap(relbig);
+	_initBatchTransforms(batch,optimize);
 	_initialized = true;
+	// Calculate our correlation multipoles
+	return transform();
+}
+
+void local::DistortedPowerCorrelation::_restoreTransformers(std::vector<double> const &veps,
+std::vector<double> const &relerr, std::vector<double> const &abserr) {
+	int nr(_rgrid.size());
+	int dell = _symmetric ? 2 : 1;
+	for(int ell = 0; ell <= _ellMax; ell += dell) {
+		int idx(ell/dell);
+		double coef = getTransformCoefficient(ell);
+		AdaptiveMultipoleTransformPtr amt(new AdaptiveMultipoleTransform(
+			MultipoleTransform::SphericalBessel,ell,coef,_rgrid,relerr[idx],abserr[idx],_abspow));
+		amt->restore(veps[idx],_minSamplesPerDecade,_optimize);
+		amt->setVerificationPolicy(_verifyPolicy,_verifyPeriod,_verifyMaxDrift);
+		_transformer[idx] = amt;
+		if(_xiMoments[idx].size() != nr) std::vector<double>(nr,0.).swap(_xiMoments[idx]);
+	}
+}
+
+bool local::DistortedPowerCorrelation::setRGrid(RGridType type, double margin) {
+	if(!isInitialized()) {
+		throw RuntimeError("DistortedPowerCorrelation::setRGrid: not initialized.");
+	}
+	std::vector<double> rgrid;
+	if(type == AdaptiveRGrid) {
+		if(margin < 1) {
+			throw RuntimeError("DistortedPowerCorrelation::setRGrid: expected margin >= 1.");
+		}
+		_getAdaptiveRGrid(margin,rgrid);
+	}
+	else if(type == NativeRGrid) {
+		_getNativeRGrid(rgrid);
+	}
+	else {
+		throw RuntimeError("DistortedPowerCorrelation::setRGrid: invalid type.");
+	}
+	_checkRGrid(rgrid);
+	// Recreate our transformers for the new grid, keeping their tuned state
+	int nell(_transformer.size());
+	std::vector<double> veps(nell), relerr(nell), abserr(nell);
+	for(int idx = 0; idx < nell; ++idx) {
+		veps[idx] = _transformer[idx]->getVEps();
+		relerr[idx] = _transformer[idx]->getRelErr();
+		abserr[idx] = _transformer[idx]->getAbsErr();
+	}
+	_rgrid.swap(rgrid);
+	_restoreTransformers(veps,relerr,abserr);
+	_initBatchTransforms(bool(_batchBetter),_optimize);
+	return transform();
+}
+
+void local::DistortedPowerCorrelation::_getAdaptiveRGrid(double margin,
+std::vector<double> &rgrid) const {
+	// Estimate the fourth derivative of each multipole at each knot from the second
+	// differences of its spline second derivatives, and the combined scale of xi.
+	int nr(_rgrid.size()), nell(_xiMoments.size());
+	std::vector<double> const &coefs = getSnapshot()->getSplineCoefficients();
+	std::vector<double> d4(nr,0.), scale(nr,0.);
+	for(int idx = 0; idx < nell; ++idx) {
+		double const *values = &coefs[2*idx*nr], *curv = values + nr;
+		for(int i = 0; i < nr; ++i) scale[i] += std::fabs(values[i]);
+		for(int i = 1; i < nr-1; ++i) {
+			double h0(_rgrid[i]-_rgrid[i-1]), h1(_rgrid[i+1]-_rgrid[i]);
+			d4[i] += std::fabs(2*((curv[i+1]-curv[i])/h1 - (curv[i]-curv[i-1])/h0)/(h0+h1));
+		}
+	}
+	// The natural spline boundary conditions bias the estimates next to each end
+	if(nr >= 5) {
+		d4[0] = d4[1] = d4[2];
+		d4[nr-1] = d4[nr-2] = d4[nr-3];
+	}
+	else {
+		double d4max = *std::max_element(d4.begin(),d4.end());
+		d4.assign(nr,d4max);
+	}
+	// Calculate the largest spacing at each knot whose cubic spline interpolation error,
+	// estimated as (5/384) h^4 |f^(4)|, meets our termination criteria with the
+	// specified margin.
+	double rmin(_rgrid.front()), rmax(_rgrid.back());
+	double hmax = (rmax - rmin)/4;
+	std::vector<double> hgrid(nr);
+	for(int i = 0; i < nr; ++i) {
+		double tol = std::max(_abserr*std::pow(_rgrid[i],_abspow),_relerr*scale[i])/margin;
+		double hmin = 0.5*(_rgrid[i < nr-1 ? i+1 : i] - _rgrid[i > 0 ? i-1 : i]);
+		double h = d4[i] > 0 ? std::pow(384./5.*tol/d4[i],0.25) : hmax;
+		hgrid[i] = std::min(hmax,std::max(hmin,h));
+	}
+	// Step through [rmin,rmax] using the spacing interpolated at each point
+	rgrid.clear();
+	rgrid.push_back(rmin);
+	int pos(0);
+	double r(rmin);
+	while(true) {
+		while(pos < nr-2 && _rgrid[pos+1] <= r) ++pos;
+		double t = (r - _rgrid[pos])/(_rgrid[pos+1] - _rgrid[pos]);
+		double h = (1-t)*hgrid[pos] + t*hgrid[pos+1];
+		r += h;
+		if(r > rmax - 0.25*h) {
+			rgrid.push_back(rmax);
+			break;
+		}
+		rgrid.push_back(r);
+	}
+}
+
+void local::DistortedPowerCorrelation::_getNativeRGrid(std::vector<double> &rgrid) const {
+	// Use the log-spaced grid shared by all multipoles in batch mode, or else the grid
+	// where the ell = 0 transform is calculated. Either grid is centered on sqrt(rmin*rmax),
+	// so extending symmetrically about this center guarantees that the new transforms
+	// (with the same veps) are calculated on exactly the same grid.
+	std::vector<double> const &vgrid = _batchBetter ?
+		_batchBetter->getVGrid() : _transformer[0]->getVGrid();
+	int nv(vgrid.size());
+	double rmin(_rgrid.front()), rmax(_rgrid.back()), v0(std::sqrt(rmin*rmax));
+	double ds = std::log(vgrid[1]/vgrid[0]);
+	int i0 = std::lower_bound(vgrid.begin(),vgrid.end(),v0*(1-1e-12)) - vgrid.begin();
+	int n = (int)std::ceil(std::log(rmax/v0)/ds - 1e-9);
+	if(i0 - n < 0 || i0 + n >= nv) {
+		throw RuntimeError("DistortedPowerCorrelation::setRGrid: native grid does not cover r range.");
+	}
+	rgrid.assign(vgrid.begin() + i0 - n, vgrid.begin() + i0 + n + 1);
+}
+
+void local::DistortedPowerCorrelation::_batchTransform(BatchMultipoleTransformCPtr batch,
+NaturalSplineResamplerCPtr resampler, bool interpolatePowerMultipoles,
+std::vector<std::vector<double> > &xi) const {
+	// Tabulate every power multipole on the shared (decreasing, log-spaced) k grid
+	std::vector<double> const &kgrid = batch->getUGrid();
+	int nell(batch->getNumMultipoles()), nk(kgrid.size());
+	std::vector<std::vector<double> > pgrid(nell,std::vector<double>(nk)), xigrid;
+	{
+		COSMO_TIME(FunctionTime);
+		COSMO_COUNT(FunctionCalls,nell*nk);
+		if(interpolatePowerMultipoles) {
+			double logk0(std::log(kgrid.front())), dlogk(std::log(kgrid.back()/kgrid.front())/(nk-1));
+			for(int idx = 0; idx < nell; ++idx) {
+				_savedPowerMultipole[idx]->evaluateLogGrid(logk0,dlogk,pgrid[idx]);
+			}
+		}
+		else {
+			// Evaluate P(k) and D(k,mu) once for all multipoles
+			_tabulatePowerMultipoles(kgrid,pgrid);
+		}
+	}
+	// Transform all multipoles together
+	batch->transform(pgrid,xigrid);
+	// Interpolate each result to our r grid and apply the transform normalization
+	COSMO_TIME(InterpolationTime);
+	if(!resampler->isExact()) {
+		COSMO_COUNT(InterpolatorBuilds,nell);
+	}
+	if(xi.size() != nell) xi.resize(nell);
+	std::vector<double> curv;
+	for(int idx = 0; idx < nell; ++idx) {
+		resampler->resample(xigrid[idx],curv,xi[idx],getTransformCoefficient(batch->getEll(idx)));
+	}
 }
 
 bool local::DistortedPowerCorrelation::transform(
@@ -251,24 +748,77 @@ bool interpolatePowerMultipoles, bool bypassTerminationTest) const {
 	bool accurate(true);
 	// Initialize our tabulated power multipoles if requested
 	if(interpolatePowerMultipoles) _initPowerMultipoles();
-	// Loop over multipoles
 	int dell = _symmetric ? 2 : 1;
-	for(int ell = 0; ell <= _ellMax; ell += dell) {
-		int idx(ell/dell);
-		// Build a function object that evaluates this multipole for arbitrary k
-		likely::GenericFunctionPtr fOfKPtr(
-			new likely::GenericFunction(boost::bind(
-				(interpolatePowerMultipoles ?
-					&DistortedPowerCorrelation::getSavedPowerMultipole :
-					&DistortedPowerCorrelation::getPowerMultipole
-				),this,_1,ell)));
-		accurate &= _transformer[idx]->transform(fOfKPtr,_xiMoments[idx],bypassTerminationTest);
-		// (re)create the interpolator for this moment
-		_interpolator[idx].reset(new likely::Interpolator(_rgrid,_xiMoments[idx],"cspline"));
+	if(_batchBetter) {
+		// Transform all multipoles together
+		_batchTransform(_batchBetter,_batchResampleBetter,interpolatePowerMultipoles,_xiMoments);
+		bool verify(!bypassTerminationTest && _verifyPolicy != AdaptiveMultipoleTransform::NeverVerify);
+		if(verify && _verifyPolicy == AdaptiveMultipoleTransform::PeriodicVerify &&
+		_batchSinceVerified >= 0 && _batchLastAccurate && _batchSinceVerified+1 < _verifyPeriod) {
+			// Skip this verification and report the last result
+			_batchSinceVerified++;
+			verify = false;
+			accurate = _batchLastAccurate;
+		}
+		if(verify) {
+			COSMO_COUNT(Verifications,1);
+			// Compare with the 2*veps batch using the termination criteria of each multipole
+			std::vector<std::vector<double> > xiGood;
+			_batchTransform(_batchGood,_batchResampleGood,interpolatePowerMultipoles,xiGood);
+			for(int idx = 0; idx < _xiMoments.size(); ++idx) {
+				if(_transformer[idx]->getErrorRatio(xiGood[idx],_xiMoments[idx]) > 1) {
+					accurate = false;
+				}
+			}
+			_batchLastAccurate = accurate;
+			_batchSinceVerified = 0;
+		}
+		_publishSnapshot();
+		return accurate;
+	}
+	// Transform each multipole independently. When using our saved power multipoles,
+	// each task only reads its own tabulated multipole so the tasks can run in parallel.
+	// Otherwise, P(k) is evaluated directly and we fall back to a serial loop.
+	int nell(_xiMoments.size());
+	std::string error;
+	#pragma omp parallel for schedule(dynamic,1) if(_parallel && interpolatePowerMultipoles) reduction(&&:accurate)
+	for(int idx = 0; idx < nell; ++idx) {
+		int ell(idx*dell);
+		try {
+			bool ok;
+			if(interpolatePowerMultipoles) {
+				// Evaluate our saved multipole directly on each transform's log-spaced k grid
+				ok = _transformer[idx]->transform(_getSavedPowerMultipoleGrid(ell),
+					_xiMoments[idx],bypassTerminationTest);
+			}
+			else {
+				// Build a function object that evaluates this multipole for arbitrary k
+				likely::GenericFunctionPtr fOfKPtr(
+					new likely::GenericFunction(boost::bind(
+						&DistortedPowerCorrelation::getPowerMultipole,this,_1,ell)));
+				ok = _transformer[idx]->transform(fOfKPtr,_xiMoments[idx],bypassTerminationTest);
+			}
+			accurate = accurate && ok;
+		}
+		catch(std::exception const &e) {
+			#pragma omp critical (DistortedPowerCorrelation_error)
+			if(error.empty()) error = e.what();
+		}
 	}
+	if(!error.empty()) throw RuntimeError(error);
+	_publishSnapshot();
 	return accurate;
 }
 
+void local::DistortedPowerCorrelation::getCorrelation(CorrelationProjector const &projector,
+std::vector<double> &xi) const {
+	CorrelationSnapshotCPtr snapshot(getSnapshot());
+	if(!snapshot) {
+		throw RuntimeError("DistortedPowerCorrelation::getCorrelation: not initialized.");
+	}
+	snapshot->getCorrelation(projector,xi);
+}
+
 local::AdaptiveMultipoleTransformCPtr local::DistortedPowerCorrelation::getTransform(int ell) const {
 	if(ell < 0 || ell > _ellMax || (_symmetric && (ell%2))) {
 		throw RuntimeError("DistortedPowerCorrelation::getTransform: invalid ell.");
@@ -302,6 +852,10 @@ void local::DistortedPowerCorrelation::printToStream(std::ostream &out) const {
     	<< _rgrid.front() << ',' << _rgrid.back() << "] Mpc/h" << std::endl;
 	out << "using " << (_symmetric ? "even" : "even+odd") << " multipoles up to ell = "
 		<< _ellMax << std::endl;
+    if(_muNodes.size() > 0) {
+        out << "power multipoles use " << _muNodes.size()
+            << "-point Gauss-Legendre quadrature in mu_k" << std::endl;
+    }
     for(int ell = 0; ell <= _ellMax; ell += dell) {
         getBiggestContribution(ell,r,mu,rel);
         cosmo::AdaptiveMultipoleTransformCPtr amt = getTransform(ell);
@@ -312,5 +866,15 @@ void local::DistortedPowerCorrelation::printToStream(std::ostream &out) const {
 		out << "  veps = " << amt->getVEps() << ", kmin = " << amt->getUMin() << " h/Mpc, kmax = "
 			<< amt->getUMax() << " h/Mpc, nk = " << amt->getNU() << " ("
 			<< (int)std::floor(amt->getUSamplesPerDecade()) << " samples/decade)" << std::endl;
-    }	
+    }
+    if(_batchBetter) {
+        out << "using batch transforms of all multipoles with nk = "
+            << _batchBetter->getUGrid().size() << " covering k = ["
+            << _batchBetter->getUGrid().back() << ',' << _batchBetter->getUGrid().front()
+            << "] h/Mpc" << std::endl;
+    }
+    if(instrument::isEnabled()) {
+        out << "accumulated instrumentation:" << std::endl;
+        instrument::printToStream(out);
+    }
 }
@@ -4,16 +4,20 @@
 #define COSMO_DISTORTED_POWER_CORRELATION
 
 #include "cosmo/types.h"
+#include "cosmo/AdaptiveMultipoleTransform.h"
 #include "likely/types.h"
 #include "likely/function.h"
 
 #include "boost/smart_ptr.hpp"
 
 #include <vector>
+#include <string>
 #include <iosfwd>
 
 namespace cosmo {
-	class AdaptiveMultipoleTransform;
+	class BatchMultipoleTransform;
+	class NaturalSplineResampler;
+	class CorrelationProjector;
 	class DistortedPowerCorrelation {
 	// Represents the 3D correlation function corresponding to an isotropic power
 	// spectrum P(k) that is distorted by a multiplicative function D(k,mu_k).
@@ -30,6 +34,23 @@ namespace cosmo {
 	// numerical tolerances that should be sufficient for "small" variations
 	// of D(k,mu_k). Note that initialize() includes the work of transform(),
 	// so the transform() step can be skipped for the initial D(k,mu_k).
+	//
+	// When symmetric is false, D(k,mu_k) can include terms that are odd in mu_k, e.g., for
+	// cross correlations. A real xi(r,mu_r) requires that the odd part of P(k,mu_k) is
+	// imaginary, so the odd part of the real D(k,mu_k) provided is interpreted as the
+	// coefficient of i, i.e., P(k,mu_k) = P(k)*(D_even(k,mu_k) + i*D_odd(k,mu_k)).
+	//
+	// When compiled with OpenMP, the k-space multipoles are tabulated and transformed
+	// in parallel, so D(k,mu_k) must be safe to evaluate concurrently unless parallel
+	// evaluation is disabled with setParallel(false). P(k) is always evaluated from a
+	// single thread.
+	//
+	// Each transform publishes its results as an immutable CorrelationSnapshot that is
+	// swapped in atomically, so other threads can evaluate xi(r,mu) while a new transform
+	// is running without blocking or seeing a partial update. Threads that need several
+	// evaluations to be consistent with each other should call getSnapshot() once and use
+	// the snapshot directly. Only the xi(r,mu) read path is safe to use concurrently with
+	// initialize(), transform(), restore() or setRGrid().
 	public:
 		// Creates a new distorted power correlation function using the specified
 		// isotropic power P(k) and distortion function D(k,mu). The k-space multipoles
@@ -37,14 +58,27 @@ namespace cosmo {
 		// covering [klo,khi], with power-law extrapolation beyond this range.
 		// The resulting correlation function will be valid over [rmin,rmax] and estimated
 		// using multipoles up to ellMax that are interpolated using nr equally-spaced
-		// points in r. If symmetric is true, then only even multipoles are used.
+		// points in r (see also setRGrid()). If symmetric is true, then only even multipoles are used.
 		// The desired accuracy is specified by relerr, abserr, and abspow, such that
 		// the difference between the true and estimated xi(r,mu) satisfies:
 		// |true-est| < max(abserr*r^abspow,true*true)
+		// If nmuQuadrature > 0, the k-space multipoles are calculated using a fixed
+		// Gauss-Legendre quadrature in mu_k, so that D(k,mu_k) is evaluated once per k at
+		// nmuQuadrature nodes (over 0 < mu_k < 1 when symmetric) and all multipoles are
+		// obtained from a precomputed Legendre weight matrix. Otherwise, each multipole is
+		// calculated with a separate adaptive integration.
 		DistortedPowerCorrelation(likely::GenericFunctionPtr power, RMuFunctionCPtr distortion,
 			double klo, double khi, int nk, double rmin, double rmax, int nr,
 			int ellMax, bool symmetric = true,
-			double relerr = 1e-2, double abserr = 1e-3, double abspow = 0);
+			double relerr = 1e-2, double abserr = 1e-3, double abspow = 0,
+			int nmuQuadrature = 0);
+		// Creates a new distorted power correlation function whose multipoles are tabulated
+		// on the increasing, and possibly non-uniform, r grid provided.
+		DistortedPowerCorrelation(likely::GenericFunctionPtr power, RMuFunctionCPtr distortion,
+			double klo, double khi, int nk, std::vector<double> const &rgrid,
+			int ellMax, bool symmetric = true,
+			double relerr = 1e-2, double abserr = 1e-3, double abspow = 0,
+			int nmuQuadrature = 0);
 		virtual ~DistortedPowerCorrelation();
 		// Returns the value of P(k,mu) = P(k)*D(k,mu). This is fast to evaluate and
 		// does not require that initialize() be called first.
@@ -67,21 +101,84 @@ namespace cosmo {
 		// to evaluate, only involving some interpolation, but requires that initialize()
 		// be called first.
 		double getCorrelation(double r, double mu) const;
+		// Fills the vector provided with the correlation function xi(r,mu) evaluated at each
+		// point of the projector provided, which must have been created for this object
+		// with its current r grid (or else a RuntimeError is thrown).
+		// This gives the same results as calling getCorrelation(r,mu) for each point, but
+		// is much faster when evaluating many points.
+		void getCorrelation(CorrelationProjector const &projector, std::vector<double> &xi) const;
+		// Returns a shared pointer to the immutable correlation multipoles published by the
+		// most recent transform, or an empty pointer if we have never been initialized.
+		CorrelationSnapshotCPtr getSnapshot() const;
 		// Initializes our multipole estimates and correlation transforms and automatically
 		// sets the relerr and abserr goals for each multipole based on their relative
 		// contributions in [rmin,rmax], determined by sampling a nr-by-nmu grid. For other
 		// options, see AdaptiveMultipoleTransform::initialize(). The value of
 		// minSamplesPerDecade is chosen to match the nk samples covering [klo,khi]
-		// specified in our constructor.
+		// specified in our constructor. If batch is true, the veps values selected for each
+		// multipole are then used to build a BatchMultipoleTransform that shares a single
+		// k grid between all multipoles and is used by subsequent calls to transform().
+		// A batch shares the tabulation of P(k) and D(k,mu) and packs pairs of multipoles
+		// into each FFT, but its FFTs are not split between OpenMP threads, so it is mainly
+		// useful for single-threaded transforms.
 		void initialize(int nmu = 20, double margin = 2,
-			double vepsMax = 0.01, double vepsMin = 1e-6, bool optimize = false);
+			double vepsMax = 0.01, double vepsMin = 1e-6, bool optimize = false,
+			bool batch = false);
+		// Saves the state determined by initialize() to a compact binary file: the veps and
+		// error targets of each multipole and the location of its biggest relative
+		// contribution. If saveWisdom is true, the accumulated FFTW planner wisdom is also
+		// saved, which makes subsequent optimized restores fast.
+		void save(std::string const &filename, bool saveWisdom = false) const;
+		// Restores the state saved by an earlier call to save() from an object created with
+		// the same constructor arguments, which are checked, and then calls transform() and
+		// returns its result. This replaces the call to initialize(), which is much slower.
+		// See initialize() for the optimize and batch options.
+		bool restore(std::string const &filename, bool optimize = false, bool batch = false);
 		// Tests if we have ever been initialized.
 		bool isInitialized() const;
+		// Options for replacing the r grid selected in our constructor after initialize():
+		//  - AdaptiveRGrid chooses non-uniform r spacings so that the cubic spline
+		//    interpolation error of xi(r,mu), estimated from the fourth derivatives of the
+		//    current multipoles, meets our termination criteria with the specified margin.
+		//    This is normally used to thin out a dense initial grid.
+		//  - NativeRGrid uses the log-spaced grid where the transforms are calculated,
+		//    extended to cover [rmin,rmax], so that their results are not re-interpolated.
+		//    In batch mode, this grid is shared by all multipoles. Otherwise, each multipole
+		//    has its own grid and we use the ell = 0 grid, so only the ell = 0 results
+		//    avoid re-interpolation.
+		enum RGridType { AdaptiveRGrid, NativeRGrid };
+		// Replaces our r grid and recreates our transforms using the veps and error targets
+		// selected by initialize(), then calls transform() and returns its result. Any
+		// CorrelationProjector created for the previous grid is no longer valid.
+		bool setRGrid(RGridType type, double margin = 2);
 		// Transforms the k-space power multipoles to r space. Returns true if the termination
 		// criteria are met, unless bypassTerminationTest is true (in which case we
-		// always return true and transforms will be somewhat faster).
+		// always return true and transforms will be somewhat faster). When initialized
+		// in batch mode, all multipoles are transformed together and the termination
+		// criteria of each AdaptiveMultipoleTransform are applied to the batch results.
 		bool transform(bool interpolatePowerMultipoles = true,
 			bool bypassTerminationTest = false) const;
+		// Sets the policy that transform() uses to verify the termination criteria of each
+		// multipole, which otherwise roughly doubles the cost of each transform. See
+		// AdaptiveMultipoleTransform::setVerificationPolicy() for details. In batch mode,
+		// PeriodicVerify checks the batch every period transforms and after any failure,
+		// but does not monitor drift. The policy is retained when our transforms are
+		// recreated by initialize(), restore() or setRGrid().
+		void setVerificationPolicy(AdaptiveMultipoleTransform::VerificationPolicy policy,
+			int period = 10, double maxDrift = 0.1);
+		// Selects whether D(k,mu_k) is tabulated and our multipoles are transformed using
+		// parallel OpenMP threads (the default). Use false when D(k,mu_k) is not safe to
+		// evaluate concurrently, e.g., because it caches its last result. This has no
+		// effect unless compiled with OpenMP.
+		void setParallel(bool parallel);
+		// Tests if parallel OpenMP evaluation is enabled.
+		bool isParallel() const;
+		// Returns the grid of r values where our correlation multipoles are tabulated.
+		std::vector<double> const &getRGrid() const;
+		// Returns the maximum multipole used.
+		int getEllMax() const;
+		// Tests if only even multipoles are used.
+		bool isSymmetric() const;
 		// Returns a shared const pointer to the specified transform.
 		AdaptiveMultipoleTransformCPtr getTransform(int ell) const;
 		// Fills the variables provided with the (r,mu) coordinates where the specified
@@ -98,16 +195,49 @@ namespace cosmo {
 		RMuFunctionCPtr _distortion;
 		double _relerr,_abserr,_abspow;
 		int _ellMax, _minSamplesPerDecade;
-		bool _symmetric, _initialized;
+		bool _symmetric, _initialized, _parallel;
 		std::vector<double> _kgrid, _rgrid, _rbig, _mubig, _relbig;
+		std::vector<double> _muNodes, _legendreWeights;
 		void _initPowerMultipoles() const;
+		// Tabulates P(k) times each multipole of D(k,mu) at the k values provided, evaluating
+		// P(k) and the quadrature nodes of D(k,mu) (if any) once per k for all multipoles.
+		void _tabulatePowerMultipoles(std::vector<double> const &kgrid,
+			std::vector<std::vector<double> > &pgrid) const;
+		double _getDistortionMultipole(double k, int ell) const;
+		// Immutable xi multipole tables published by the last transform
+		mutable CorrelationSnapshotCPtr _snapshot;
+		void _publishSnapshot() const;
 		mutable std::vector<cosmo::TabulatedPowerCPtr> _savedPowerMultipole;
+		// Returns a function that evaluates a saved power multipole on a log-spaced k grid.
+		AdaptiveMultipoleTransform::LogGridFunctionPtr _getSavedPowerMultipoleGrid(int ell) const;
 		mutable std::vector<std::vector<double> > _xiMoments;
-		mutable std::vector<likely::InterpolatorPtr> _interpolator;
 		std::vector<AdaptiveMultipoleTransformPtr> _transformer;
+		typedef boost::shared_ptr<const BatchMultipoleTransform> BatchMultipoleTransformCPtr;
+		BatchMultipoleTransformCPtr _batchGood, _batchBetter;
+		// Interpolation from each batch's v grid to our r grid
+		typedef boost::shared_ptr<const NaturalSplineResampler> NaturalSplineResamplerCPtr;
+		NaturalSplineResamplerCPtr _batchResampleGood, _batchResampleBetter;
+		bool _optimize;
+		AdaptiveMultipoleTransform::VerificationPolicy _verifyPolicy;
+		int _verifyPeriod;
+		double _verifyMaxDrift;
+		mutable int _batchSinceVerified;
+		mutable bool _batchLastAccurate;
+		void _checkRGrid(std::vector<double> const &rgrid) const;
+		void _setup(double klo, double khi, int nk, int nmuQuadrature);
+		void _restoreTransformers(std::vector<double> const &veps,
+			std::vector<double> const &relerr, std::vector<double> const &abserr);
+		void _getAdaptiveRGrid(double margin, std::vector<double> &rgrid) const;
+		void _getNativeRGrid(std::vector<double> &rgrid) const;
+		void _initBatchTransforms(bool batch, bool optimize);
+		void _batchTransform(BatchMultipoleTransformCPtr batch, NaturalSplineResamplerCPtr resampler,
+			bool interpolatePowerMultipoles, std::vector<std::vector<double> > &xi) const;
 	}; // DistortedPowerCorrelation
 
 	inline bool DistortedPowerCorrelation::isInitialized() const { return _initialized; }
+	inline std::vector<double> const &DistortedPowerCorrelation::getRGrid() const { return _rgrid; }
+	inline int DistortedPowerCorrelation::getEllMax() const { return _ellMax; }
+	inline bool DistortedPowerCorrelation::isSymmetric() const { return _symmetric; }
 
 } // cosmo
 
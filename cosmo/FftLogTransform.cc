@@ -0,0 +1,211 @@
+// Created 18-Oct-2026
+
+#include "cosmo/FftLogTransform.h"
+#include "cosmo/RuntimeError.h"
+#include "cosmo/Instrumentation.h"
+
+#include "config.h"
+#ifdef HAVE_LIBFFTW3
+#include "fftw3.h"
+#define FFTW(X) fftw_ ## X // double transforms
+#endif
+
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace local = cosmo;
+
+namespace cosmo {
+    struct FftLogTransform::Implementation {
+#ifdef HAVE_LIBFFTW3
+        double *rdata;
+        FFTW(complex) *cdata;
+        FFTW(plan) forward,backward;
+#endif
+    };
+} // cosmo::
+
+namespace cosmo {
+namespace fftlog {
+	typedef std::complex<double> Complex;
+	// Returns the log of sin(pi*z) up to an irrelevant multiple of 2*pi*i, using a form
+	// that does not overflow for large |Im(z)|.
+	Complex logSinPi(Complex z) {
+		double pi(atan2(0,-1));
+		Complex ipz(-pi*z.imag(),pi*z.real());
+		if(z.imag() >= 0) {
+			return -ipz + std::log(1. - std::exp(2.*ipz)) - std::log(Complex(0,-2));
+		}
+		else {
+			return ipz + std::log(1. - std::exp(-2.*ipz)) - std::log(Complex(0,2));
+		}
+	}
+	// Returns log(Gamma(z)) for complex z using the Lanczos approximation (g=7,n=9)
+	// with reflection for Re(z) < 1/2, which is accurate to ~1e-15.
+	Complex logGamma(Complex z) {
+		static const double p[9] = {
+			0.99999999999980993, 676.5203681218851, -1259.1392167224028,
+			771.32342877765313, -176.61502916214059, 12.507343278686905,
+			-0.13857109526572012, 9.9843695780195716e-6, 1.5056327351493116e-7 };
+		double pi(atan2(0,-1));
+		if(z.real() < 0.5) {
+			return std::log(pi) - logSinPi(z) - logGamma(1.-z);
+		}
+		z -= 1.;
+		Complex x(p[0]);
+		for(int i = 1; i < 9; ++i) x += p[i]/(z + (double)i);
+		Complex t = z + 7.5;
+		return 0.5*std::log(2*pi) + (z + 0.5)*std::log(t) - t + std::log(x);
+	}
+	// Returns the log of the Mellin transform Integrate[x^(z-1) K(x),{x,0,Infinity}]
+	// of the kernel K = j_ell(x) (SphericalBessel) or J_ell(x) (Hankel).
+	Complex logMellin(MultipoleTransform::Type type, int ell, Complex z) {
+		double pi(atan2(0,-1)), ln2(std::log(2.)), nu(ell);
+		if(type == MultipoleTransform::SphericalBessel) {
+			return 0.5*std::log(pi) + (z-2.)*ln2 + logGamma(0.5*(nu+z)) - logGamma(0.5*(3.+nu-z));
+		}
+		else {
+			return (z-1.)*ln2 + logGamma(0.5*(nu+z)) - logGamma(1.+0.5*(nu-z));
+		}
+	}
+}} // cosmo::fftlog
+
+local::FftLogTransform::FftLogTransform(MultipoleTransform::Type type, int ell,
+double vmin, double vmax, double umin, double umax, double samplesPerDecade, double bias,
+MultipoleTransform::Strategy strategy, int interpolationPadding) :
+_bias(bias), _pimpl(new Implementation())
+{
+#ifndef HAVE_LIBFFTW3
+	throw RuntimeError("FftLogTransform: library not built with fftw3 support.");
+#endif
+	// Input parameter validation
+	if(type != MultipoleTransform::SphericalBessel && type != MultipoleTransform::Hankel) {
+		throw RuntimeError("FftLogTransform: invalid type.");
+	}
+	if(ell < 0) {
+		throw RuntimeError("FftLogTransform: expected ell >= 0.");
+	}
+	if(vmin <= 0 || vmin >= vmax) {
+		throw RuntimeError("FftLogTransform: expected 0 < vmin < vmax.");
+	}
+	if(umin <= 0 || umin >= umax) {
+		throw RuntimeError("FftLogTransform: expected 0 < umin < umax.");
+	}
+	if(samplesPerDecade <= 0) {
+		throw RuntimeError("FftLogTransform: expected samplesPerDecade > 0.");
+	}
+	if(interpolationPadding < 0) {
+		throw RuntimeError("FftLogTransform: expected interpolationPadding >= 0.");
+	}
+	double biasMax = (type == MultipoleTransform::SphericalBessel) ? 2 : 1.5;
+	if(bias <= -ell || bias >= biasMax) {
+		throw RuntimeError("FftLogTransform: bias is outside the convergence strip.");
+	}
+	double pi(atan2(0,-1));
+	double ds = std::log(10.)/samplesPerDecade;
+	// Pick the log(u) range to cover [umin,umax] and the u = 1/v values corresponding
+	// to [vmin,vmax]. Add one extra point on each side since the low-ringing
+	// adjustment below can shift u*v by up to one grid spacing.
+	int pad = interpolationPadding + 1;
+	double lnuMax = std::log(umax), lnuMin = std::log(umin);
+	if(lnuMax < -std::log(vmin) + pad*ds) lnuMax = -std::log(vmin) + pad*ds;
+	if(lnuMin > -std::log(vmax) - pad*ds) lnuMin = -std::log(vmax) - pad*ds;
+	_N = (int)std::ceil((lnuMax - lnuMin)/ds) + 1;
+	if(_N % 2) _N++;
+	// Adjust log(u*v) from zero to the nearest value where the Nyquist kernel
+	// coefficient is real, which minimizes ringing (eqn (C6) of Hamilton 2000).
+	double etaNyquist = pi/ds;
+	fftlog::Complex zNyquist(bias,-etaNyquist);
+	double argM = std::imag(fftlog::logMellin(type,ell,zNyquist));
+	double lnuv = (pi*std::floor(argM/pi + 0.5) - argM)/etaNyquist;
+	_uv = std::exp(lnuv);
+	// Tabulate the (decreasing) u grid and the coefficients needed to rescale func(u)
+	// to the biased input of the FFT.
+	int d = (type == MultipoleTransform::SphericalBessel) ? 3 : 2;
+	double u0 = std::exp(lnuMax);
+	_ugrid.reserve(_N);
+	_coef.reserve(_N);
+	for(int n = 0; n < _N; ++n) {
+		double s = n*ds, u = u0*std::exp(-s);
+		_ugrid.push_back(u);
+		_coef.push_back(std::pow(u,d)*std::exp(bias*s));
+	}
+	// Tabulate the (increasing) v grid v(k) = uv/u(k) and the corresponding output scale
+	// factors, keeping only the subrange that covers [vmin,vmax] with padding.
+	double v0 = _uv/u0;
+	int kmin = (int)std::floor(std::log(vmin/v0)/ds) - interpolationPadding;
+	int kmax = (int)std::ceil(std::log(vmax/v0)/ds) + interpolationPadding;
+	if(kmin < 0 || kmax >= _N) {
+		throw RuntimeError("FftLogTransform: internal error calculating v grid.");
+	}
+	_vBegin = kmin;
+	_vgrid.reserve(kmax-kmin+1);
+	_scale.reserve(kmax-kmin+1);
+	for(int k = kmin; k <= kmax; ++k) {
+		double s = k*ds;
+		_vgrid.push_back(v0*std::exp(s));
+		_scale.push_back(std::pow(_uv*std::exp(s),-bias)/_N);
+	}
+	// Tabulate the kernel coefficients (u*v)^(i*eta) M(bias - i*eta) for eta = 2pi*m/(N*ds)
+	// and m = 0,1,...,N/2.
+	int nk = _N/2 + 1;
+	_kernel.resize(2*nk);
+	for(int m = 0; m < nk; ++m) {
+		double eta = 2*pi*m/(_N*ds);
+		fftlog::Complex z(bias,-eta);
+		fftlog::Complex w = std::exp(fftlog::logMellin(type,ell,z) + fftlog::Complex(0,eta*lnuv));
+		_kernel[2*m] = w.real();
+		// The Nyquist coefficient must be real for a real-valued result.
+		_kernel[2*m+1] = (m == _N/2) ? 0 : w.imag();
+	}
+#ifdef HAVE_LIBFFTW3
+	// Allocate SIMD aligned arrays using FFTW's allocator
+	_pimpl->rdata = (double*)FFTW(malloc)(sizeof(double)*_N);
+	_pimpl->cdata = (FFTW(complex)*)FFTW(malloc)(sizeof(FFTW(complex))*nk);
+	int flags = (strategy == MultipoleTransform::EstimatePlan) ? FFTW_ESTIMATE : FFTW_MEASURE;
+	_pimpl->forward = FFTW(plan_dft_r2c_1d)(_N,_pimpl->rdata,_pimpl->cdata,flags);
+	_pimpl->backward = FFTW(plan_dft_c2r_1d)(_N,_pimpl->cdata,_pimpl->rdata,flags);
+#endif
+}
+
+local::FftLogTransform::~FftLogTransform() {
+#ifdef HAVE_LIBFFTW3
+    FFTW(destroy_plan)(_pimpl->forward);
+    FFTW(destroy_plan)(_pimpl->backward);
+    FFTW(free)(_pimpl->rdata);
+    FFTW(free)(_pimpl->cdata);
+#endif
+}
+
+void local::FftLogTransform::transform(std::vector<double> const &funcTable,
+std::vector<double> &result) const {
+#ifndef HAVE_LIBFFTW3
+	throw RuntimeError("FftLogTransform: library not built with fftw3 support.");
+#else
+	COSMO_TIME(FftTime);
+	COSMO_COUNT(FftExecutions,2);
+	int nv(_vgrid.size());
+	if(funcTable.size() != _N) {
+		throw RuntimeError("FftLogTransform::transform: funcTable has wrong size.");
+	}
+	// (re)initialize result vector to have correct size, if necessary
+	if(result.size() != nv) std::vector<double>(nv,0).swap(result);
+	for(int n = 0; n < _N; ++n) {
+		_pimpl->rdata[n] = _coef[n]*funcTable[n];
+	}
+	FFTW(execute)(_pimpl->forward);
+	// Multiply by the kernel coefficients.
+	for(int m = 0; m <= _N/2; ++m) {
+		double re1 = _pimpl->cdata[m][0], im1 = _pimpl->cdata[m][1];
+		double re2 = _kernel[2*m], im2 = _kernel[2*m+1];
+		_pimpl->cdata[m][0] = re1*re2 - im1*im2;
+		_pimpl->cdata[m][1] = re1*im2 + re2*im1;
+	}
+	FFTW(execute)(_pimpl->backward);
+	// Rescale and copy the results back to the vector provided.
+	for(int k = 0; k < nv; ++k) {
+		result[k] = _scale[k]*_pimpl->rdata[k + _vBegin];
+	}
+#endif
+}
@@ -0,0 +1,86 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_FFT_LOG_TRANSFORM
+#define COSMO_FFT_LOG_TRANSFORM
+
+#include "cosmo/AbsMultipoleTransform.h"
+#include "cosmo/MultipoleTransform.h"
+
+#include "boost/smart_ptr.hpp"
+
+#include <vector>
+
+namespace cosmo {
+	class FftLogTransform : public AbsMultipoleTransform {
+	// Calculates 2D (Hankel) or 3D (spherical Bessel) multipole transforms of
+	// an arbitrary real-valued function using the FFTLog algorithm of Hamilton 2000
+	// (http://arxiv.org/abs/astro-ph/9905191). Evaluates the same integrals as
+	// MultipoleTransform, but uses the analytic Mellin transform of the Bessel kernel
+	// (a ratio of Gamma functions) instead of a sampled kernel, so that only a single
+	// real FFT of the input table, without zero padding, is needed in each direction.
+	// The price is that the input func(u) is treated as periodic in log(u), so its
+	// tabulated range [umin,umax] must be wide enough for u^d*func(u)*u^(-bias) to be
+	// negligible at both ends, where d = 3 (SphericalBessel) or 2 (Hankel).
+	public:
+		// Creates a new transform object for an arbitrary func(u) that evaluates:
+		//
+		//   T(v) = Integrate[ S(ell,u,v)*func(u) , {u,0,Infinity} ]
+		//
+		// where S = u^2 j_ell(u*v) when type is SphericalBessel or
+		// S = u J_ell(u*v) when type is Hankel. The function will be tabulated with
+		// the specified number of logarithmic samples per decade over a range that
+		// includes [umin,umax] and is wide enough to cover vmin < v < vmax, padded
+		// by interpolationPadding points on each side. The bias exponent must satisfy
+		// -ell < bias < 2 (SphericalBessel) or -ell < bias < 3/2 (Hankel) and should
+		// be chosen to minimize the dynamic range of u^(d-bias)*func(u). For a typical
+		// 3D power spectrum transformed to a correlation function, bias = 1.5 works well.
+		FftLogTransform(MultipoleTransform::Type type, int ell, double vmin, double vmax,
+			double umin, double umax, double samplesPerDecade, double bias,
+			MultipoleTransform::Strategy strategy = MultipoleTransform::EstimatePlan,
+			int interpolationPadding = 3);
+		virtual ~FftLogTransform();
+		// Returns the bias exponent used by this transform.
+		double getBias() const;
+		// Returns the product u*v of corresponding points on our u and v grids, after
+		// adjustment to the nearest low-ringing value.
+		double getUVProduct() const;
+		// Returns the number of logarithmically spaced points used for the FFT.
+		int getNumPoints() const;
+		// Returns the grid of u values where a function to be transformed should be
+		// evaluated when preparing the funcTable for calling the transform(...) method.
+		// Note that the values in u grid are always strictly decreasing (!) and positive.
+		virtual std::vector<double> const &getUGrid() const;
+		// Returns the subrange of the v grid that covers [vmin,vmax] with
+		// interpolationPadding points on each side.
+		virtual std::vector<double> const &getVGrid() const;
+		// Estimates the transform of func on our v grid using the the specified
+		// values of func(u) tabulated on our u grid. The results are saved in
+		// the results vector provided, which will be resized to our vgrid size
+		// if necessary.
+		virtual void transform(std::vector<double> const &funcTable,
+			std::vector<double> &result) const;
+	private:
+		double _bias, _uv;
+		int _N, _vBegin;
+		std::vector<double> _ugrid, _vgrid, _coef, _scale;
+		// Complex FFTLog kernel coefficients for m = 0,1,...,N/2 stored as (re,im) pairs.
+		std::vector<double> _kernel;
+		// We use an implementation subclass to avoid any public include dependency
+		// on fftw, since this is an optional package when building our library.
+		class Implementation;
+		boost::scoped_ptr<Implementation> _pimpl;
+	}; // FftLogTransform
+
+	inline double FftLogTransform::getBias() const { return _bias; }
+	inline double FftLogTransform::getUVProduct() const { return _uv; }
+	inline int FftLogTransform::getNumPoints() const { return _N; }
+	inline std::vector<double> const &FftLogTransform::getUGrid() const {
+		return _ugrid;
+	}
+	inline std::vector<double> const &FftLogTransform::getVGrid() const {
+		return _vgrid;
+	}
+
+} // cosmo
+
+#endif // COSMO_FFT_LOG_TRANSFORM
@@ -0,0 +1,101 @@
+// Created 18-Oct-2026
+
+#include "cosmo/Instrumentation.h"
+#include "cosmo/RuntimeError.h"
+
+#include "boost/format.hpp"
+
+#include <iostream>
+#include <sys/time.h>
+
+namespace local = cosmo::instrument;
+
+namespace cosmo {
+namespace instrument {
+	// Accumulated totals, which are updated atomically since the transforms can run on
+	// several OpenMP threads.
+	double timerTotal[NumTimers] = { 0 };
+	long timerCalls[NumTimers] = { 0 };
+	long counterTotal[NumCounters] = { 0 };
+	char const *timerName[NumTimers] = {
+		"power multipoles", "function evaluation", "fft", "interpolation", "snapshot" };
+	char const *counterName[NumCounters] = {
+		"function calls", "fft executions", "interpolator builds", "veps halvings", "verifications" };
+	double wallTime() {
+		struct timeval tv;
+		gettimeofday(&tv,0);
+		return tv.tv_sec + 1e-6*tv.tv_usec;
+	}
+} // instrument
+} // cosmo
+
+bool local::isEnabled() {
+#ifdef COSMO_INSTRUMENT
+	return true;
+#else
+	return false;
+#endif
+}
+
+double local::getTime(Timer timer) {
+	if(timer < 0 || timer >= NumTimers) {
+		throw RuntimeError("instrument::getTime: invalid timer.");
+	}
+	return timerTotal[timer];
+}
+
+long local::getTimerCalls(Timer timer) {
+	if(timer < 0 || timer >= NumTimers) {
+		throw RuntimeError("instrument::getTimerCalls: invalid timer.");
+	}
+	return timerCalls[timer];
+}
+
+long local::getCount(Counter counter) {
+	if(counter < 0 || counter >= NumCounters) {
+		throw RuntimeError("instrument::getCount: invalid counter.");
+	}
+	return counterTotal[counter];
+}
+
+void local::reset() {
+	for(int i = 0; i < NumTimers; ++i) {
+		timerTotal[i] = 0;
+		timerCalls[i] = 0;
+	}
+	for(int i = 0; i < NumCounters; ++i) counterTotal[i] = 0;
+}
+
+void local::printToStream(std::ostream &out) {
+	if(!isEnabled()) {
+		out << "Instrumentation is not enabled (configure with --enable-instrumentation)." << std::endl;
+		return;
+	}
+	for(int i = 0; i < NumTimers; ++i) {
+		out << boost::format("%20s %10.4f s %10d calls\n") % timerName[i]
+			% timerTotal[i] % timerCalls[i];
+	}
+	for(int i = 0; i < NumCounters; ++i) {
+		out << boost::format("%20s %10d\n") % counterName[i] % counterTotal[i];
+	}
+}
+
+void local::addCount(Counter counter, long count) {
+	long &total = counterTotal[counter];
+	#pragma omp atomic
+	total += count;
+}
+
+local::ScopedTimer::ScopedTimer(Timer timer)
+: _timer(timer), _start(wallTime())
+{ }
+
+local::ScopedTimer::~ScopedTimer() {
+	double elapsed = wallTime() - _start;
+	double &total = timerTotal[_timer];
+	long &calls = timerCalls[_timer];
+	#pragma omp atomic
+	total += elapsed;
+	#pragma omp atomic
+	calls += 1;
+}
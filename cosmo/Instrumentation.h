@@ -0,0 +1,77 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_INSTRUMENTATION
+#define COSMO_INSTRUMENTATION
+
+#include <iosfwd>
+
+// Optional instrumentation of the transform hot paths. The timers and counters below are
+// only updated when the library is compiled with COSMO_INSTRUMENT defined, using
+//
+//   ./configure --enable-instrumentation
+//
+// Otherwise the COSMO_TIME and COSMO_COUNT macros expand to nothing, so there is no
+// runtime cost, and the query functions below always report zero.
+
+namespace cosmo {
+	namespace instrument {
+		// Named timers. Times are summed over threads, so can exceed the elapsed time
+		// when multipoles are processed in parallel.
+		enum Timer {
+			PowerMultipoleTime,     // tabulating the k-space multipoles of P(k,mu)
+			FunctionTime,           // evaluating transform inputs on a u grid
+			FftTime,                // FFT convolutions, including any rescaling
+			InterpolationTime,      // building and evaluating transform output interpolators
+			SnapshotTime,           // building published correlation snapshots
+			NumTimers
+		};
+		// Named counters.
+		enum Counter {
+			FunctionCalls,          // evaluations of a transform input function
+			FftExecutions,          // FFTW plan executions
+			InterpolatorBuilds,     // interpolators created for transform outputs
+			VepsHalvings,           // veps reductions during AdaptiveMultipoleTransform::initialize
+			Verifications,          // 2*veps verification transforms
+			NumCounters
+		};
+		// Tests if the library was compiled with instrumentation enabled.
+		bool isEnabled();
+		// Returns the accumulated wall time in seconds for the specified timer.
+		double getTime(Timer timer);
+		// Returns the number of times the specified timer has been started.
+		long getTimerCalls(Timer timer);
+		// Returns the accumulated value of the specified counter.
+		long getCount(Counter counter);
+		// Resets all timers and counters to zero.
+		void reset();
+		// Prints a summary of all timers and counters to the specified output stream.
+		void printToStream(std::ostream &out);
+		// Adds to the specified counter. Normally called via COSMO_COUNT.
+		void addCount(Counter counter, long count);
+		// Accumulates the wall time between construction and destruction to the specified
+		// timer. Normally created via COSMO_TIME.
+		class ScopedTimer {
+		public:
+			explicit ScopedTimer(Timer timer);
+			~ScopedTimer();
+		private:
+			Timer _timer;
+			double _start;
+		}; // ScopedTimer
+	} // instrument
+} // cosmo
+
+#ifdef COSMO_INSTRUMENT
+#define COSMO_INSTRUMENT_CONCAT2(A,B) A##B
+#define COSMO_INSTRUMENT_CONCAT(A,B) COSMO_INSTRUMENT_CONCAT2(A,B)
+// Times the rest of the enclosing scope using the named cosmo::instrument::Timer.
+#define COSMO_TIME(NAME) cosmo::instrument::ScopedTimer \
+	COSMO_INSTRUMENT_CONCAT(cosmoScopedTimer,__LINE__)(cosmo::instrument::NAME)
+// Adds N to the named cosmo::instrument::Counter.
+#define COSMO_COUNT(NAME,N) cosmo::instrument::addCount(cosmo::instrument::NAME,(N))
+#else
+#define COSMO_TIME(NAME)
+#define COSMO_COUNT(NAME,N)
+#endif
+
+#endif // COSMO_INSTRUMENTATION
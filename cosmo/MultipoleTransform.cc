@@ -2,16 +2,11 @@
 
 #include "cosmo/MultipoleTransform.h"
 #include "cosmo/RuntimeError.h"
+#include "cosmo/Instrumentation.h"
 
 #include "config.h"
 #ifdef HAVE_LIBFFTW3
 #include "fftw3.h"
-#define FFTW(X) fftw_ ## X // double transforms
-typedef double FftwReal;
-//#define FFTW(X) fftwf_ ## X // float transforms
-//typedef float FftwReal;
-//#define FFTW(X) fftwl_ ## X // long double transforms
-//typedef long double FftwReal;
 #endif
 
 #include <boost/math/special_functions/gamma.hpp>
@@ -24,22 +19,128 @@ typedef double FftwReal;
 namespace local = cosmo;
 
 namespace cosmo {
-    struct MultipoleTransform::Implementation {
+    // Defines a uniform interface to the double and float FFTW libraries.
+    template <class Real> struct Fftw;
 #ifdef HAVE_LIBFFTW3
-        FFTW(complex) *fdata,*gdata;
-        FFTW(plan) fplan,gplan,fgplan;
+    template <> struct Fftw<double> {
+        typedef fftw_complex Complex;
+        typedef fftw_plan Plan;
+        static Complex *allocate(int n) { return (Complex*)fftw_malloc(sizeof(Complex)*n); }
+        static void free(Complex *data) { fftw_free(data); }
+        static Plan plan(int n, Complex *data, int sign, unsigned flags) {
+            return fftw_plan_dft_1d(n,data,data,sign,flags);
+        }
+        static void execute(Plan plan) { fftw_execute(plan); }
+        static void destroy(Plan plan) { fftw_destroy_plan(plan); }
+    };
 #endif
+#ifdef HAVE_LIBFFTW3F
+    template <> struct Fftw<float> {
+        typedef fftwf_complex Complex;
+        typedef fftwf_plan Plan;
+        static Complex *allocate(int n) { return (Complex*)fftwf_malloc(sizeof(Complex)*n); }
+        static void free(Complex *data) { fftwf_free(data); }
+        static Plan plan(int n, Complex *data, int sign, unsigned flags) {
+            return fftwf_plan_dft_1d(n,data,data,sign,flags);
+        }
+        static void execute(Plan plan) { fftwf_execute(plan); }
+        static void destroy(Plan plan) { fftwf_destroy_plan(plan); }
+    };
+#endif
+    // Defines the interface of our FFT convolution engine.
+    class AbsConvolution {
+    public:
+        virtual ~AbsConvolution() { }
+        // Stores the Fourier transform of the real-valued kernel provided, which is
+        // always calculated in double precision.
+        virtual void setKernel(std::vector<double> const &kernel) = 0;
+        // Convolves coef[m]*func[m] with the kernel and saves scale[m]*result[m+begin]
+        // in the result array provided, for m = 0,1,...,n-1.
+        virtual void convolve(double const *coef, double const *func, double const *scale,
+            int begin, int n, double *result) const = 0;
+    };
+#ifdef HAVE_LIBFFTW3
+    // Implements our FFT convolution using the specified floating-point type to store
+    // and transform the data. All other arithmetic is performed in double precision.
+    template <class Real> class FftwConvolution : public AbsConvolution {
+    public:
+        typedef Fftw<Real> F;
+        FftwConvolution(int size, MultipoleTransform::Strategy strategy) : _size(size) {
+            // Allocate SIMD aligned arrays using FFTW's allocator
+            _fdata = F::allocate(_size);
+            _gdata = F::allocate(_size);
+            // Build plans for doing transforms in place.
+            int flags = (strategy == MultipoleTransform::EstimatePlan) ? FFTW_ESTIMATE : FFTW_MEASURE;
+            _gplan = F::plan(_size,_gdata,FFTW_FORWARD,flags);
+            _fgplan = F::plan(_size,_gdata,FFTW_BACKWARD,flags);
+        }
+        virtual ~FftwConvolution() {
+            F::destroy(_gplan);
+            F::destroy(_fgplan);
+            F::free(_fdata);
+            F::free(_gdata);
+        }
+        virtual void setKernel(std::vector<double> const &kernel) {
+            // Calculate the Fourier transform of the kernel in double precision.
+            Fftw<double>::Complex *data = Fftw<double>::allocate(_size);
+            Fftw<double>::Plan plan = Fftw<double>::plan(_size,data,FFTW_FORWARD,FFTW_ESTIMATE);
+            for(int m = 0; m < _size; ++m) {
+                data[m][0] = kernel[m];
+                data[m][1] = 0;
+            }
+            Fftw<double>::execute(plan);
+            // Save the result with the normalization of the inverse transform applied.
+            double norm(_size);
+            for(int m = 0; m < _size; ++m) {
+                _fdata[m][0] = (Real)(data[m][0]/norm);
+                _fdata[m][1] = (Real)(data[m][1]/norm);
+            }
+            Fftw<double>::destroy(plan);
+            Fftw<double>::free(data);
+        }
+        virtual void convolve(double const *coef, double const *func, double const *scale,
+        int begin, int n, double *result) const {
+            for(int m = 0; m < _size; ++m) {
+                _gdata[m][0] = (Real)(coef[m]*func[m]);
+                _gdata[m][1] = 0.;
+            }
+            // Calculate the Fourier transform of gdata
+            F::execute(_gplan);
+            // Multiply the transforms of fdata and gdata, saving the result in gdata
+            for(int m = 0; m < _size; ++m) {
+                double re1 = _fdata[m][0], im1 = _fdata[m][1];
+                double re2 = _gdata[m][0], im2 = _gdata[m][1];
+                _gdata[m][0] = (Real)(re1*re2 - im1*im2);
+                _gdata[m][1] = (Real)(re1*im2 + re2*im1);
+            }
+            // Calculate the inverse Fourier transform that gives the convolution of
+            // the original fdata and gdata.
+            F::execute(_fgplan);
+            // Rescale and copy the results back to the array provided.
+            for(int m = 0; m < n; ++m) {
+                result[m] = scale[m]*(double)_gdata[m + begin][0];
+            }
+        }
+    private:
+        int _size;
+        typename F::Complex *_fdata,*_gdata;
+        typename F::Plan _gplan,_fgplan;
+    };
+#endif
+    struct MultipoleTransform::Implementation {
+        boost::scoped_ptr<AbsConvolution> engine;
     };
 } // cosmo::
 
 local::MultipoleTransform::MultipoleTransform(Type type, int ell,
 double vmin, double vmax, double veps, Strategy strategy,
-int minSamplesPerCycle, int minSamplesPerDecade, int interpolationPadding) :
-_type(type),_minSamplesPerCycle(minSamplesPerCycle),
+int minSamplesPerCycle, int minSamplesPerDecade, int interpolationPadding, Kernel kernel,
+Precision precision) :
+_type(type),_precision(precision),_minSamplesPerCycle(minSamplesPerCycle),
 _pimpl(new Implementation())
 {
 #ifndef HAVE_LIBFFTW3
-	throw RuntimeError("MultipoleTransform: library not built with fftw3f support.");
+	throw RuntimeError("MultipoleTransform: library not built with fftw3 support.");
 #endif
 	// Input parameter validation
 	if(_type != SphericalBessel && _type != Hankel) {
@@ -63,6 +164,17 @@ _pimpl(new Implementation())
 	if(minSamplesPerDecade < 0) {
 		throw RuntimeError("MultipoleTransform: expected minSamplesPerDecade >= 0.");
 	}
+	if(kernel != FastKernel && kernel != ExactKernel) {
+		throw RuntimeError("MultipoleTransform: invalid kernel.");
+	}
+	if(precision != DoublePrecision && precision != SinglePrecision) {
+		throw RuntimeError("MultipoleTransform: invalid precision.");
+	}
+#ifndef HAVE_LIBFFTW3F
+	if(precision == SinglePrecision) {
+		throw RuntimeError("MultipoleTransform: library not built with fftw3f support.");
+	}
+#endif
 	double pi(atan2(0,-1));
 	double alpha, uv0, s0;
 	if(_type == SphericalBessel) {
@@ -128,41 +240,67 @@ _pimpl(new Implementation())
 	int Ng = (int)std::ceil(std::log(vmax/vmin)/(2*ds)+interpolationPadding);
 	// Tabulate f(s) of eqn (1.4) or (2.2)
 	int Ntot = _Nf + Ng;
+	// The single-precision FFT roundoff error is proportional to the dynamic range of
+	// the data being convolved, so we tilt g(s) by exp(-tilt*s) and undo this after the
+	// convolution in double precision. The tilt is chosen so that the convolved data is
+	// u^(3/2)*func(u) for SphericalBessel or u*func(u) for Hankel, which is roughly
+	// flat for a typical P(k) and keeps the errors below 1e-6 for ell <= 4.
+	double tilt(0);
+	if(precision == SinglePrecision) {
+		tilt = (_type == SphericalBessel) ? alpha - 1.5 : alpha - 1;
+	}
 #ifdef HAVE_LIBFFTW3
-	// Allocate SIMD aligned arrays using FFTW's allocator
-	_pimpl->fdata = (FFTW(complex)*)FFTW(malloc)(sizeof(FFTW(complex))*2*Ntot);
-	_pimpl->gdata = (FFTW(complex)*)FFTW(malloc)(sizeof(FFTW(complex))*2*Ntot);
-	// Build plans for doing transforms in place. FFTW is supposed to be smart
-	// about re-using plans with the same dimensions but different arrays.
-	int flags = (strategy == EstimatePlan) ? FFTW_ESTIMATE : FFTW_MEASURE;
-	_pimpl->fplan = FFTW(plan_dft_1d)(2*Ntot,_pimpl->fdata,_pimpl->fdata,
-		FFTW_FORWARD,flags);
-	_pimpl->gplan = FFTW(plan_dft_1d)(2*Ntot,_pimpl->gdata,_pimpl->gdata,
-		FFTW_FORWARD,flags);
-	_pimpl->fgplan = FFTW(plan_dft_1d)(2*Ntot,_pimpl->gdata,_pimpl->gdata,
-		FFTW_BACKWARD,flags);
-	for(int m = 0; m < 2*Ntot; ++m) {
-		long double xarg;
+	// Create the FFT convolution engine for the requested precision.
+	if(precision == DoublePrecision) {
+		_pimpl->engine.reset(new FftwConvolution<double>(2*Ntot,strategy));
+	}
+#ifdef HAVE_LIBFFTW3F
+	else {
+		_pimpl->engine.reset(new FftwConvolution<float>(2*Ntot,strategy));
+	}
+#endif
+	// Tabulate the kernel. Each sample is independent so this loop can be
+	// split between threads when compiled with OpenMP support.
+	int Nkernel(2*Ntot);
+	std::vector<double> kernelData(Nkernel);
+	#pragma omp parallel for
+	for(int m = 0; m < Nkernel; ++m) {
 		int n = m;
 		if(n >= Ntot) n -= 2*Ntot;
 		if(std::abs(n) > _Nf) {
-			_pimpl->fdata[m][0] = _pimpl->fdata[m][1] = 0.;
+			kernelData[m] = 0.;
+		}
+		else if(kernel == FastKernel) {
+			double bessel,s = n*ds, xarg = uv0*std::exp(s);
+			if(_type == SphericalBessel) {
+				bessel = sphericalBesselJ(ell,xarg);
+			}
+			else {
+				bessel = cylindricalBesselJ(ell,xarg);
+			}
+			kernelData[m] = std::exp(alpha*s)*bessel*ds;
 		}
 		else {
-			long double bessel,s = n*ds;
-			xarg = uv0*std::exp(s);
+			long double bessel,s = n*ds, xarg = uv0*std::exp(s);
 			if(_type == SphericalBessel) {
 				bessel = boost::math::sph_bessel(ell,xarg);
 			}
 			else {
 				bessel = boost::math::cyl_bessel_j(ell,xarg);
 			}
-			_pimpl->fdata[m][0] = std::exp(alpha*s)*bessel*ds;
-			_pimpl->fdata[m][1] = 0.;
+			kernelData[m] = std::exp(alpha*s)*bessel*ds;
+		}
+	}
+	// Apply the opposite tilt to the kernel (see below), so that the convolution of
+	// the tilted inputs is exact for the clean part of our v grid.
+	if(tilt != 0) {
+		for(int m = 0; m < Nkernel; ++m) {
+			int n = (m < Ntot) ? m : m - 2*Ntot;
+			kernelData[m] *= std::exp(-tilt*n*ds);
 		}
 	}
-	// Calculate the Fourier transform of fdata
-	FFTW(execute)(_pimpl->fplan);
+	// Calculate and save the Fourier transform of the kernel.
+	_pimpl->engine->setKernel(kernelData);
 #endif
 	// Tabulate the u values where func(u) should be evaluated, the
 	// coefficients needed to rescale func(u(s)) to g(s), the v values
@@ -177,57 +315,31 @@ _pimpl(new Implementation())
 		double v, s = n*ds;
 		_ugrid.push_back(u0*std::exp(-s));
 		if(_type == SphericalBessel) {
-			_coef.push_back(ds*std::exp((3-alpha)*(-s))*u03);
+			_coef.push_back(ds*std::exp((3-alpha+tilt)*(-s))*u03);
 		}
 		else {
-			_coef.push_back(ds*std::exp((2-alpha)*(-s))*u02);
+			_coef.push_back(ds*std::exp((2-alpha+tilt)*(-s))*u02);
 		}
 		if(n + Ntot >= _cleanBegin && n + Ntot < _cleanEnd) {
 			_vgrid.push_back(v = v0*std::exp(+s));
-			_scale.push_back(std::pow(v/v0,-alpha)/ds);
+			_scale.push_back(std::pow(v/v0,-alpha)*std::exp(tilt*s)/ds);
 		}
 	}
 }
 
-local::MultipoleTransform::~MultipoleTransform() {
-#ifdef HAVE_LIBFFTW3
-    FFTW(destroy_plan)(_pimpl->fplan);
-    FFTW(destroy_plan)(_pimpl->gplan);
-    FFTW(destroy_plan)(_pimpl->fgplan);
-    FFTW(free)(_pimpl->fdata);
-    FFTW(free)(_pimpl->gdata);
-#endif
-}
+local::MultipoleTransform::~MultipoleTransform() { }
 
 void local::MultipoleTransform::transform(std::vector<double> const &funcTable,
 std::vector<double> &result) const {
 #ifndef HAVE_LIBFFTW3
 	throw RuntimeError("MultipoleTransform: library not built with fftw3 support.");
 #else
-	int nu(_ugrid.size()), nv(_vgrid.size());
+	COSMO_TIME(FftTime);
+	COSMO_COUNT(FftExecutions,2);
+	int nv(_vgrid.size());
 	// (re)initialize result vector to have correct size, if necessary
 	if(result.size() != nv) std::vector<double>(nv,0).swap(result);
-	for(int m = 0; m < nu; ++m) {
-		_pimpl->gdata[m][0] = (FftwReal)(_coef[m]*funcTable[m]);
-		_pimpl->gdata[m][1] = 0.;
-	}
-	// Calculate the Fourier transform of gdata
-	FFTW(execute)(_pimpl->gplan);
-	// Multiply the transforms of fdata and gdata, saving the result in gdata
-	double norm(nu);
-	for(int m = 0; m < nu; ++m) {
-		double re1 = _pimpl->fdata[m][0], im1 = _pimpl->fdata[m][1];
-		double re2 = _pimpl->gdata[m][0], im2 = _pimpl->gdata[m][1];
-		_pimpl->gdata[m][0] = (FftwReal)((re1*re2 - im1*im2)/norm);
-		_pimpl->gdata[m][1] = (FftwReal)((re1*im2 + re2*im1)/norm);
-	}
-	// Calculate the inverse Fourier transform that gives the convolution of
-	// the original fdata and gdata, tabulated on vgrid.
-	FFTW(execute)(_pimpl->fgplan);
-	// Rescale and copy the results back to the vector provided.
-	for(int m = 0; m < _cleanEnd - _cleanBegin; ++m) {
-		result[m] = _scale[m]*_pimpl->gdata[m + _cleanBegin][0];
-	}
+	_pimpl->engine->convolve(&_coef[0],&funcTable[0],&_scale[0],_cleanBegin,nv,&result[0]);
 #endif
 }
 
@@ -255,3 +367,124 @@ double a, double b) {
 	if((ell/2) % 2) coef = -coef;
 	return coef;
 }
+
+double local::sphericalBesselJ(int ell, double x) {
+	if(ell < 0) {
+		throw RuntimeError("sphericalBesselJ: expected ell >= 0.");
+	}
+	if(x < 0) {
+		throw RuntimeError("sphericalBesselJ: expected x >= 0.");
+	}
+	if(x < ell + 1) {
+		// Use the power series x^ell/(2ell+1)!! Sum[(-x^2/2)^k/(k!(2ell+3)...(2ell+2k+1))]
+		// which converges quickly with little cancellation in this range.
+		double prefactor(1), x2(x*x);
+		for(int i = 1; i <= ell; ++i) prefactor *= x/(2*i+1);
+		double term(1), sum(1);
+		for(int k = 1; k < 100; ++k) {
+			term *= -0.5*x2/(k*(2*(ell+k)+1));
+			sum += term;
+			if(std::fabs(term) < 1e-17*std::fabs(sum)) break;
+		}
+		return prefactor*sum;
+	}
+	// Use an upward recurrence, which is stable for x > ell.
+	double sinx(std::sin(x)), cosx(std::cos(x));
+	double jm1(sinx/x);
+	if(ell == 0) return jm1;
+	double j(sinx/(x*x) - cosx/x);
+	for(int i = 1; i < ell; ++i) {
+		double jp1 = (2*i+1)/x*j - jm1;
+		jm1 = j;
+		j = jp1;
+	}
+	return j;
+}
+
+double local::cylindricalBesselJ(int ell, double x) {
+	if(ell < 0) {
+		throw RuntimeError("cylindricalBesselJ: expected ell >= 0.");
+	}
+	if(x < 0) {
+		throw RuntimeError("cylindricalBesselJ: expected x >= 0.");
+	}
+	if(x < ell + 1) {
+		// Use the power series (x/2)^ell/ell! Sum[(-x^2/4)^k/(k!(ell+1)...(ell+k))]
+		double prefactor(1), x2(x*x);
+		for(int i = 1; i <= ell; ++i) prefactor *= 0.5*x/i;
+		double term(1), sum(1);
+		for(int k = 1; k < 100; ++k) {
+			term *= -0.25*x2/(k*(ell+k));
+			sum += term;
+			if(std::fabs(term) < 1e-17*std::fabs(sum)) break;
+		}
+		return prefactor*sum;
+	}
+	if(x > 25 + ell*ell) {
+		// Use Hankel's asymptotic expansion, truncated at its smallest term.
+		double pi(atan2(0,-1)), mu(4.*ell*ell), z(8*x);
+		double P(1), Q(0), term(1);
+		for(int k = 1; k < 50; ++k) {
+			double next = term*(mu - (2*k-1)*(2*k-1))/(k*z);
+			if(std::fabs(next) >= std::fabs(term)) break;
+			term = next;
+			switch(k % 4) {
+				case 0: P += term; break;
+				case 1: Q += term; break;
+				case 2: P -= term; break;
+				case 3: Q -= term; break;
+			}
+			if(std::fabs(term) < 1e-17) break;
+		}
+		// Expand cos(x-phi) and sin(x-phi) to avoid roundoff in x-phi for large x.
+		double phi((0.5*ell + 0.25)*pi), sinx(std::sin(x)), cosx(std::cos(x));
+		double cosphi(std::cos(phi)), sinphi(std::sin(phi));
+		double coschi = cosx*cosphi + sinx*sinphi, sinchi = sinx*cosphi - cosx*sinphi;
+		return std::sqrt(2/(pi*x))*(P*coschi - Q*sinchi);
+	}
+	// Use an upward recurrence from boost's rational approximations for J_0 and J_1,
+	// which is stable for x > ell.
+	double jm1 = boost::math::cyl_bessel_j(0,x);
+	if(ell == 0) return jm1;
+	double j = boost::math::cyl_bessel_j(1,x);
+	for(int i = 1; i < ell; ++i) {
+		double jp1 = (2*i)/x*j - jm1;
+		jm1 = j;
+		j = jp1;
+	}
+	return j;
+}
+
+std::string local::exportTransformWisdom(MultipoleTransform::Precision precision) {
+	char *wisdom(0);
+	if(precision == MultipoleTransform::SinglePrecision) {
+#ifdef HAVE_LIBFFTW3F
+		wisdom = fftwf_export_wisdom_to_string();
+#endif
+	}
+	else {
+#ifdef HAVE_LIBFFTW3
+		wisdom = fftw_export_wisdom_to_string();
+#endif
+	}
+	if(0 == wisdom) return std::string();
+	std::string result(wisdom);
+	// FFTW allocates the exported string with malloc
+	std::free(wisdom);
+	return result;
+}
+
+bool local::importTransformWisdom(std::string const &wisdom, MultipoleTransform::Precision precision) {
+	if(wisdom.empty()) return false;
+	if(precision == MultipoleTransform::SinglePrecision) {
+#ifdef HAVE_LIBFFTW3F
+		return 0 != fftwf_import_wisdom_from_string(wisdom.c_str());
+#endif
+	}
+	else {
+#ifdef HAVE_LIBFFTW3
+		return 0 != fftw_import_wisdom_from_string(wisdom.c_str());
+#endif
+	}
+	return false;
+}
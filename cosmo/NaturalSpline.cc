@@ -0,0 +1,109 @@
+// Created 18-Oct-2026
+
+#include "cosmo/NaturalSpline.h"
+#include "cosmo/RuntimeError.h"
+
+#include <cmath>
+
+namespace local = cosmo;
+
+void local::factorNaturalSpline(int n, double const *x, double *diag, double *upper, int stride) {
+	if(n < 2) {
+		throw RuntimeError("factorNaturalSpline: expected n >= 2.");
+	}
+	// The first and last rows just set M[0] = M[n-1] = 0
+	diag[0] = 1;
+	upper[0] = 0;
+	for(int i = 1; i < n-1; ++i) {
+		double h0(x[i]-x[i-1]), h1(x[i+1]-x[i]);
+		diag[i*stride] = 2*(h0+h1) - h0*upper[(i-1)*stride];
+		upper[i*stride] = h1/diag[i*stride];
+	}
+	diag[(n-1)*stride] = 1;
+	upper[(n-1)*stride] = 0;
+}
+
+void local::solveNaturalSpline(int n, double const *x, double const *diag, double const *upper,
+double const *y, double *curv, int stride) {
+	// Forward elimination
+	curv[0] = 0;
+	for(int i = 1; i < n-1; ++i) {
+		double h0(x[i]-x[i-1]), h1(x[i+1]-x[i]);
+		double rhs = 6*((y[(i+1)*stride]-y[i*stride])/h1 - (y[i*stride]-y[(i-1)*stride])/h0);
+		curv[i*stride] = (rhs - h0*curv[(i-1)*stride])/diag[i*stride];
+	}
+	// Back substitution
+	curv[(n-1)*stride] = 0;
+	for(int i = n-2; i > 0; --i) {
+		curv[i*stride] -= upper[i*stride]*curv[(i+1)*stride];
+	}
+}
+
+local::NaturalSplineResampler::NaturalSplineResampler(std::vector<double> const &grid,
+std::vector<double> const &points)
+: _grid(grid), _exact(true)
+{
+	int ngrid(grid.size()), npoints(points.size());
+	if(ngrid < 2) {
+		throw RuntimeError("NaturalSplineResampler: expected at least 2 grid values.");
+	}
+	_segment.resize(npoints);
+	_weights.resize(4*npoints);
+	int pos(0);
+	for(int i = 0; i < npoints; ++i) {
+		double x(points[i]);
+		if(x < grid.front()*(1-1e-12) || x > grid.back()*(1+1e-12)) {
+			throw RuntimeError("NaturalSplineResampler: point outside grid.");
+		}
+		if(i > 0 && x < points[i-1]) {
+			throw RuntimeError("NaturalSplineResampler: points are not increasing.");
+		}
+		// Both grids are increasing so we only need to scan forwards
+		while(pos < ngrid-1 && grid[pos] < x*(1-1e-12)) ++pos;
+		if(std::fabs(grid[pos] - x) <= 1e-12*std::fabs(x)) {
+			_segment[i] = -1-pos;
+			continue;
+		}
+		int j = pos-1;
+		double h(grid[j+1]-grid[j]);
+		double b((x-grid[j])/h), a(1-b);
+		double *w = &_weights[4*i];
+		w[0] = a;
+		w[1] = b;
+		w[2] = (a*a*a-a)*h*h/6;
+		w[3] = (b*b*b-b)*h*h/6;
+		_segment[i] = j;
+		_exact = false;
+	}
+	if(!_exact) {
+		_diag.resize(ngrid);
+		_upper.resize(ngrid);
+		factorNaturalSpline(ngrid,&_grid[0],&_diag[0],&_upper[0]);
+	}
+}
+
+local::NaturalSplineResampler::~NaturalSplineResampler() { }
+
+void local::NaturalSplineResampler::resample(std::vector<double> const &values,
+std::vector<double> &curv, std::vector<double> &result, double scale) const {
+	int ngrid(_grid.size()), npoints(_segment.size());
+	if(values.size() != ngrid) {
+		throw RuntimeError("NaturalSplineResampler::resample: values have the wrong size.");
+	}
+	double const *y = &values[0];
+	if(!_exact) {
+		if(curv.size() != ngrid) curv.resize(ngrid);
+		solveNaturalSpline(ngrid,&_grid[0],&_diag[0],&_upper[0],y,&curv[0]);
+	}
+	if(result.size() != npoints) std::vector<double>(npoints).swap(result);
+	for(int i = 0; i < npoints; ++i) {
+		int j(_segment[i]);
+		if(j < 0) {
+			result[i] = scale*y[-1-j];
+		}
+		else {
+			double const *w = &_weights[4*i];
+			result[i] = scale*(w[0]*y[j] + w[1]*y[j+1] + w[2]*curv[j] + w[3]*curv[j+1]);
+		}
+	}
+}
@@ -0,0 +1,65 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_NATURAL_SPLINE
+#define COSMO_NATURAL_SPLINE
+
+#include <vector>
+
+namespace cosmo {
+
+	// The natural cubic spline through values y[i] tabulated at increasing x[i], i = 0..n-1,
+	// is determined by its second derivatives M[i], with M[0] = M[n-1] = 0. Between x[j] and
+	// x[j+1] the spline is:
+	//
+	//   f(x) = a*y[j] + b*y[j+1] + ((a^3-a)*M[j] + (b^3-b)*M[j+1])*h^2/6
+	//
+	// with h = x[j+1]-x[j], b = (x-x[j])/h and a = 1-b. This is the same interpolating
+	// function as a likely::Interpolator using "cspline". The M[i] solve a tridiagonal system
+	// whose matrix only depends on x, so it is factored once by factorNaturalSpline() and
+	// then solved for any y by solveNaturalSpline(). The diag, upper, y and curv arrays are
+	// all accessed as array[i*stride], which allows them to be interleaved with other data.
+
+	// Calculates the forward elimination factors diag[i] and upper[i] of the tridiagonal
+	// system for the n >= 2 increasing values x[i].
+	void factorNaturalSpline(int n, double const *x, double *diag, double *upper, int stride = 1);
+
+	// Calculates the second derivatives curv[i] of the natural cubic spline through y[i]
+	// using factors calculated by factorNaturalSpline(). The y and curv arrays must not
+	// overlap.
+	void solveNaturalSpline(int n, double const *x, double const *diag, double const *upper,
+		double const *y, double *curv, int stride = 1);
+
+	class NaturalSplineResampler {
+	// Evaluates the natural cubic spline through values tabulated on a fixed grid at a fixed
+	// set of points. The spline factors, the segment containing each point and its spline
+	// weights are all calculated once, so each evaluation only requires one tridiagonal solve
+	// and 4 multiply-adds per point. Points that coincide with a grid value are copied
+	// directly and, if every point coincides, no solve is needed.
+	public:
+		// Creates a resampler from the increasing grid to the increasing points provided,
+		// which must lie within the grid (up to a relative roundoff of 1e-12).
+		NaturalSplineResampler(std::vector<double> const &grid, std::vector<double> const &points);
+		virtual ~NaturalSplineResampler();
+		// Fills result with scale times the spline through values (tabulated on our grid)
+		// evaluated at each of our points. The curv vector is used as workspace. Both
+		// vectors are resized if necessary.
+		void resample(std::vector<double> const &values, std::vector<double> &curv,
+			std::vector<double> &result, double scale = 1) const;
+		// Returns true if every point coincides with a grid value.
+		bool isExact() const;
+	private:
+		std::vector<double> _grid;
+		// Index of the grid segment containing each point, or -1-i for a point that
+		// coincides with grid[i].
+		std::vector<int> _segment;
+		// Spline weights of y[j], y[j+1], M[j], M[j+1] for each point.
+		std::vector<double> _weights;
+		std::vector<double> _diag, _upper;
+		bool _exact;
+	}; // NaturalSplineResampler
+
+	inline bool NaturalSplineResampler::isExact() const { return _exact; }
+
+} // cosmo
+
+#endif // COSMO_NATURAL_SPLINE
@@ -0,0 +1,119 @@
+// Created 18-Oct-2026
+
+#include "cosmo/SeparableDistortedPowerCorrelation.h"
+#include "cosmo/DistortedPowerCorrelation.h"
+#include "cosmo/CorrelationSnapshot.h"
+#include "cosmo/RuntimeError.h"
+
+#include <iostream>
+
+namespace local = cosmo;
+
+local::SeparableDistortedPowerCorrelation::SeparableDistortedPowerCorrelation(
+likely::GenericFunctionPtr power, std::vector<RMuFunctionCPtr> const &terms,
+double klo, double khi, int nk, double rmin, double rmax, int nr,
+int ellMax, bool symmetric, double relerr, double abserr, double abspow, int nmuQuadrature)
+: _ellMax(ellMax), _symmetric(symmetric), _initialized(false)
+{
+	int nterms(terms.size());
+	if(nterms == 0) {
+		throw RuntimeError("SeparableDistortedPowerCorrelation: expected at least one term.");
+	}
+	// Create a correlation function for each term (which validates our other inputs)
+	_terms.reserve(nterms);
+	for(int i = 0; i < nterms; ++i) {
+		_terms.push_back(DistortedPowerCorrelationPtr(new DistortedPowerCorrelation(
+			power,terms[i],klo,khi,nk,rmin,rmax,nr,ellMax,symmetric,relerr,abserr,abspow,
+			nmuQuadrature)));
+	}
+	_coefs.resize(nterms,1.);
+}
+
+local::SeparableDistortedPowerCorrelation::~SeparableDistortedPowerCorrelation() { }
+
+local::DistortedPowerCorrelationCPtr
+local::SeparableDistortedPowerCorrelation::getTerm(int index) const {
+	if(index < 0 || index >= _terms.size()) {
+		throw RuntimeError("SeparableDistortedPowerCorrelation::getTerm: invalid index.");
+	}
+	return _terms[index];
+}
+
+void local::SeparableDistortedPowerCorrelation::initialize(int nmu, double margin,
+double vepsMax, double vepsMin, bool optimize) {
+	for(int i = 0; i < _terms.size(); ++i) {
+		_terms[i]->initialize(nmu,margin,vepsMax,vepsMin,optimize);
+	}
+	_combine();
+	_initialized = true;
+}
+
+bool local::SeparableDistortedPowerCorrelation::transformTerm(int index,
+bool interpolatePowerMultipoles, bool bypassTerminationTest) {
+	if(!isInitialized()) {
+		throw RuntimeError("SeparableDistortedPowerCorrelation::transformTerm: not initialized.");
+	}
+	if(index < 0 || index >= _terms.size()) {
+		throw RuntimeError("SeparableDistortedPowerCorrelation::transformTerm: invalid index.");
+	}
+	bool accurate = _terms[index]->transform(interpolatePowerMultipoles,bypassTerminationTest);
+	_combine();
+	return accurate;
+}
+
+void local::SeparableDistortedPowerCorrelation::setParallel(bool parallel) {
+	for(int i = 0; i < _terms.size(); ++i) _terms[i]->setParallel(parallel);
+}
+
+void local::SeparableDistortedPowerCorrelation::setCoefficients(std::vector<double> const &coefs) {
+	if(coefs.size() != _terms.size()) {
+		throw RuntimeError("SeparableDistortedPowerCorrelation::setCoefficients: wrong number of coefficients.");
+	}
+	_coefs = coefs;
+	if(isInitialized()) _combine();
+}
+
+void local::SeparableDistortedPowerCorrelation::_combine() {
+	std::vector<CorrelationSnapshotCPtr> snapshots;
+	snapshots.reserve(_terms.size());
+	for(int i = 0; i < _terms.size(); ++i) snapshots.push_back(_terms[i]->getSnapshot());
+	CorrelationSnapshotCPtr snapshot(new CorrelationSnapshot(snapshots,_coefs));
+	boost::atomic_store(&_snapshot,snapshot);
+}
+
+local::CorrelationSnapshotCPtr local::SeparableDistortedPowerCorrelation::getSnapshot() const {
+	return boost::atomic_load(&_snapshot);
+}
+
+double local::SeparableDistortedPowerCorrelation::getCorrelationMultipole(double r, int ell) const {
+	CorrelationSnapshotCPtr snapshot(getSnapshot());
+	if(!snapshot) {
+		throw RuntimeError("SeparableDistortedPowerCorrelation::getCorrelationMultipole: not initialized.");
+	}
+	return snapshot->getCorrelationMultipole(r,ell);
+}
+
+double local::SeparableDistortedPowerCorrelation::getCorrelation(double r, double mu) const {
+	CorrelationSnapshotCPtr snapshot(getSnapshot());
+	if(!snapshot) {
+		throw RuntimeError("SeparableDistortedPowerCorrelation::getCorrelation: not initialized.");
+	}
+	return snapshot->getCorrelation(r,mu);
+}
+
+void local::SeparableDistortedPowerCorrelation::getCorrelation(CorrelationProjector const &projector,
+std::vector<double> &xi) const {
+	CorrelationSnapshotCPtr snapshot(getSnapshot());
+	if(!snapshot) {
+		throw RuntimeError("SeparableDistortedPowerCorrelation::getCorrelation: not initialized.");
+	}
+	snapshot->getCorrelation(projector,xi);
+}
+
+void local::SeparableDistortedPowerCorrelation::printToStream(std::ostream &out) const {
+	out << "separable distortion with " << _terms.size() << " terms" << std::endl;
+	for(int i = 0; i < _terms.size(); ++i) {
+		out << "== term " << i << " with coefficient " << _coefs[i] << std::endl;
+		_terms[i]->printToStream(out);
+	}
+}
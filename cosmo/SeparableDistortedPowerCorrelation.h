@@ -0,0 +1,105 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_SEPARABLE_DISTORTED_POWER_CORRELATION
+#define COSMO_SEPARABLE_DISTORTED_POWER_CORRELATION
+
+#include "cosmo/types.h"
+#include "likely/types.h"
+#include "likely/function.h"
+
+#include <vector>
+#include <iosfwd>
+
+namespace cosmo {
+	class CorrelationProjector;
+	class SeparableDistortedPowerCorrelation {
+	// Represents the 3D correlation function corresponding to an isotropic power
+	// spectrum P(k) that is distorted by a sum of separable terms:
+	//
+	//   D(k,mu_k) = Sum_i c_i D_i(k,mu_k)
+	//
+	// where the coefficients c_i depend on model parameters but the shapes D_i(k,mu_k)
+	// change rarely (or never). Each term is transformed once and publishes a
+	// CorrelationSnapshot, so that changing the coefficients only requires forming a
+	// linear combination of the spline coefficients of each term's snapshot, with no new
+	// transforms or spline solves. The normal usage is:
+	//
+	//  - initialize() with representative D_i(k,mu_k)
+	//    - setCoefficients() each time the c_i change
+	//    - transformTerm() each time the shape of one D_i(k,mu_k) changes internally
+	//      - call getCorrelation(r,mu) or getCorrelationMultipole(r,ell) many times
+	//
+	// Note that the accuracy goals are applied to each term separately, so large
+	// cancellations between terms will reduce the relative accuracy of the sum.
+	//
+	// The combined multipoles are published as an immutable CorrelationSnapshot that is
+	// swapped in atomically, with the same thread-safety guarantees as a
+	// DistortedPowerCorrelation.
+	public:
+		// Creates a new separable distorted power correlation function using the specified
+		// isotropic power P(k) and distortion terms D_i(k,mu). The remaining parameters are
+		// used to create a DistortedPowerCorrelation for each term, and have the same meaning
+		// as in the DistortedPowerCorrelation constructor. All coefficients are initially one.
+		SeparableDistortedPowerCorrelation(likely::GenericFunctionPtr power,
+			std::vector<RMuFunctionCPtr> const &terms,
+			double klo, double khi, int nk, double rmin, double rmax, int nr,
+			int ellMax, bool symmetric = true,
+			double relerr = 1e-2, double abserr = 1e-3, double abspow = 0,
+			int nmuQuadrature = 0);
+		virtual ~SeparableDistortedPowerCorrelation();
+		// Returns the number of separable terms.
+		int getNumTerms() const;
+		// Returns a shared const pointer to the correlation function of the specified term.
+		DistortedPowerCorrelationCPtr getTerm(int index) const;
+		// Initializes the transforms of each term. See DistortedPowerCorrelation::initialize()
+		// for details.
+		void initialize(int nmu = 20, double margin = 2,
+			double vepsMax = 0.01, double vepsMin = 1e-6, bool optimize = false);
+		// Tests if we have ever been initialized.
+		bool isInitialized() const;
+		// Re-transforms the specified term after its shape has changed and updates the
+		// combined correlation function using the current coefficients. Returns the result
+		// of DistortedPowerCorrelation::transform() for this term.
+		bool transformTerm(int index, bool interpolatePowerMultipoles = true,
+			bool bypassTerminationTest = false);
+		// Selects whether each term uses parallel OpenMP threads. See
+		// DistortedPowerCorrelation::setParallel() for details.
+		void setParallel(bool parallel);
+		// Sets the coefficient c_i of each term and updates the combined correlation function.
+		// This does not require any new transforms, so is fast.
+		void setCoefficients(std::vector<double> const &coefs);
+		// Returns the current coefficients.
+		std::vector<double> const &getCoefficients() const;
+		// Returns the specified multipole of the combined xi(r,mu) evaluated at r.
+		double getCorrelationMultipole(double r, int ell) const;
+		// Returns the combined correlation function xi(r,mu).
+		double getCorrelation(double r, double mu) const;
+		// Fills the vector provided with the combined correlation function xi(r,mu) evaluated
+		// at each point of the projector provided, which must have been created for the
+		// r grid and multipoles of our terms, e.g. using *getTerm(0) (or else a RuntimeError
+		// is thrown).
+		void getCorrelation(CorrelationProjector const &projector, std::vector<double> &xi) const;
+		// Returns a shared pointer to the immutable combined correlation multipoles, or an
+		// empty pointer if we have never been initialized.
+		CorrelationSnapshotCPtr getSnapshot() const;
+		// Prints info about this object to the specified output stream.
+		void printToStream(std::ostream &out) const;
+	private:
+		int _ellMax;
+		bool _symmetric, _initialized;
+		std::vector<double> _coefs;
+		std::vector<DistortedPowerCorrelationPtr> _terms;
+		// The most recently published combination of our terms, accessed atomically.
+		CorrelationSnapshotCPtr _snapshot;
+		void _combine();
+	}; // SeparableDistortedPowerCorrelation
+
+	inline int SeparableDistortedPowerCorrelation::getNumTerms() const { return _terms.size(); }
+	inline bool SeparableDistortedPowerCorrelation::isInitialized() const { return _initialized; }
+	inline std::vector<double> const &SeparableDistortedPowerCorrelation::getCoefficients() const {
+		return _coefs;
+	}
+
+} // cosmo
+
+#endif // COSMO_SEPARABLE_DISTORTED_POWER_CORRELATION
@@ -1,11 +1,13 @@
 // Created 13-Jan-2014 by David Kirkby (University of California, Irvine) <dkirkby@uci.edu>
 
 #include "cosmo/TabulatedPower.h"
+#include "cosmo/NaturalSpline.h"
 #include "cosmo/RuntimeError.h"
 
 #include "likely/Interpolator.h"
 
 #include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 
@@ -30,6 +32,7 @@ namespace cosmo {
 				c = P1/std::pow(k1,a);
 			}
 		}
+		PowerLawExtrapolator(double a_, double c_) : a(a_), c(c_) { }
 		double operator()(double k) const { return (0 == a) ? c : c*std::pow(k,a); }
 		double a,c;
 	};
@@ -44,8 +47,8 @@ _maxRelError(maxRelError)
 	if(k.size() != Pk.size()) {
 		throw RuntimeError("TabulatedPower: input vectors have different sizes.");
 	}
-	if(k.size() < 3 && (extrapolateBelow || extrapolateAbove)) {
-		throw RuntimeError("TabulatedPower: need at least 3 points for extrapolation.");
+	if(k.size() < 3) {
+		throw RuntimeError("TabulatedPower: need at least 3 points.");
 	}
 	// Convert k to log(k)
 	std::vector<double> logk;
@@ -67,44 +70,171 @@ _maxRelError(maxRelError)
 			<< _kmin << " <= k <= " << _kmax << " (" << samplesPerDecade
 			<< " samples/decade)" << std::endl;
 	}
-	// Build a spline interpolator in log(k) and P(k)
-	_interpolator.reset(new likely::Interpolator(logk,Pk,"cspline"));
-	// Estimate a power law for extrapolating below kmin, if requested
+	// Tabulate log(k) and P(k) then calculate our spline coefficients
+	int n(k.size()), nseg(n-1);
+	_npoints = n;
+	_storage.assign(5*n,0.);
+	std::copy(logk.begin(),logk.end(),_storage.begin());
+	double *coefs = &_storage[n];
+	for(int i = 0; i < n; ++i) coefs[4*i] = Pk[i];
+	_logk = &_storage[0];
+	_coefs = coefs;
+	_fitSpline();
+	// Are the tabulated log(k) values uniformly spaced? We only need each value to be
+	// within dlogk/2 of its uniform position for _getSegment to find the right segment,
+	// so we allow for tables of log-spaced k values that were rounded when written out
+	// (e.g., %.5e gives deviations up to ~4e-4*dlogk for typical spacings).
+	double dlogk = (logk.back() - logk.front())/nseg;
+	_invDlogk = 1/dlogk;
+	for(int i = 1; i < nseg; ++i) {
+		if(std::fabs(logk[i] - (logk.front() + i*dlogk)) > 0.1*dlogk) {
+			_invDlogk = 0;
+			break;
+		}
+	}
+	if(verbose) {
+		std::cout << "TabulatedPower: k values are " << (isLogUniform() ? "" : "not ")
+			<< "logarithmically spaced" << std::endl;
+	}
+	// Estimate power laws for extrapolating below kmin and above kmax, if requested
+	if(extrapolateBelow) _extrapolateBelow.reset(new PowerLawExtrapolator(0,0));
+	if(extrapolateAbove) _extrapolateAbove.reset(new PowerLawExtrapolator(0,0));
+	_fitExtrapolation(verbose);
+}
+
+local::TabulatedPower::TabulatedPower(TabulatedPower const &other) :
+_kmin(other._kmin), _kmax(other._kmax), _maxRelError(other._maxRelError),
+_npoints(other._npoints), _storage(5*other._npoints), _invDlogk(other._invDlogk)
+{
+	std::copy(other._logk,other._logk+_npoints,_storage.begin());
+	std::copy(other._coefs,other._coefs+4*_npoints,_storage.begin()+_npoints);
+	_logk = &_storage[0];
+	_coefs = &_storage[_npoints];
+	if(other._extrapolateBelow) {
+		_extrapolateBelow.reset(new PowerLawExtrapolator(*other._extrapolateBelow));
+	}
+	if(other._extrapolateAbove) {
+		_extrapolateAbove.reset(new PowerLawExtrapolator(*other._extrapolateAbove));
+	}
+}
+
+void local::TabulatedPower::_fitSpline() {
+	// Calculate the coefficients of a natural cubic spline in log(k) and P(k) for
+	// each segment, using the tabulated values already stored in _coefs[4*i]. This
+	// is the same interpolating function as a likely::Interpolator using "cspline",
+	// up to roundoff. The unused coefficients of each point are used as workspace for
+	// the tridiagonal factors (in c[1] and c[3]) and the second derivatives (in c[2]),
+	// so that no allocation is necessary.
+	int n(_npoints), nseg(n-1);
+	double const *logk = _logk;
+	double *coefs = &_storage[n];
+	factorNaturalSpline(n,logk,coefs+1,coefs+3,4);
+	solveNaturalSpline(n,logk,coefs+1,coefs+3,coefs,coefs+2,4);
+	for(int j = 0; j < nseg; ++j) {
+		double h(logk[j+1]-logk[j]);
+		double *c = &coefs[4*j];
+		double curv0(c[2]), curv1(c[6]);
+		c[1] = (c[4]-c[0])/h - h*(2*curv0+curv1)/6;
+		c[2] = curv0/2;
+		c[3] = (curv1-curv0)/(6*h);
+	}
+	coefs[4*nseg+1] = coefs[4*nseg+2] = coefs[4*nseg+3] = 0;
+}
+
+void local::TabulatedPower::_fitExtrapolation(bool verbose) {
+	int n(_npoints);
+	double const *P = _coefs;
 	double eps(1e-14);
-	if(extrapolateBelow) {
-		_extrapolateBelow.reset(new PowerLawExtrapolator(k[0],Pk[0],k[2],Pk[2],eps));
+	// Update the power law for extrapolating below kmin, if enabled
+	if(_extrapolateBelow) {
+		double k1(std::exp(_logk[1])), k2(std::exp(_logk[2]));
+		*_extrapolateBelow = PowerLawExtrapolator(_kmin,P[0],k2,P[8],eps);
 		// Check how well the extrapolation does at k[1]
-		double P1 = (*_extrapolateBelow)(k[1]);
-		double abserr = std::fabs(P1 - Pk[1]);
-		double relerr = std::fabs(P1/Pk[1]-1.);
+		double P1 = (*_extrapolateBelow)(k1);
+		double abserr = std::fabs(P1 - P[4]);
+		double relerr = std::fabs(P1/P[4]-1.);
 		if(verbose) {
 			std::cout << "TabulatedPower: errors for extrapolation below are "
 				<< relerr << " (rel) " << abserr << " (abs)" << std::endl;
 		}
-		if(abserr > eps && relerr > maxRelError) {
+		if(abserr > eps && relerr > _maxRelError) {
 			throw RuntimeError("TabulatedPower: cannot reliably extrapolate below kmin.");
 		}
 	}
-	// Estimate a power law for extrapolating above kmax, if requested
-	if(extrapolateAbove) {
-		int n = k.size();
-		_extrapolateAbove.reset(new PowerLawExtrapolator(k[n-3],Pk[n-3],k[n-1],Pk[n-1],eps));
+	// Update the power law for extrapolating above kmax, if enabled
+	if(_extrapolateAbove) {
+		double kn3(std::exp(_logk[n-3])), kn2(std::exp(_logk[n-2]));
+		*_extrapolateAbove = PowerLawExtrapolator(kn3,P[4*(n-3)],_kmax,P[4*(n-1)],eps);
 		// Check how well the extrapolation does at k[n-2]
-		double Pn2 = (*_extrapolateAbove)(k[n-2]);
-		double abserr = std::fabs(Pn2 - Pk[n-2]);
-		double relerr = std::fabs(Pn2/Pk[n-2]-1.);
+		double Pn2 = (*_extrapolateAbove)(kn2);
+		double abserr = std::fabs(Pn2 - P[4*(n-2)]);
+		double relerr = std::fabs(Pn2/P[4*(n-2)]-1.);
 		if(verbose) {
 			std::cout << "TabulatedPower: errors for extrapolation above are "
 				<< relerr << " (rel) " << abserr << " (abs)" << std::endl;
 		}
-		if(abserr > eps && relerr > maxRelError) {
+		if(abserr > eps && relerr > _maxRelError) {
 			throw RuntimeError("TabulatedPower: cannot reliably extrapolate above kmax.");
 		}
 	}
 }
 
+bool local::TabulatedPower::hasSameGrid(TabulatedPower const &other) const {
+	if(other._npoints != _npoints) return false;
+	if(other._logk == _logk) return true;
+	return std::equal(_logk,_logk+_npoints,other._logk);
+}
+
+void local::TabulatedPower::setValues(std::vector<double> const &Pk) {
+	if(_owner) {
+		throw RuntimeError("TabulatedPower::setValues: cannot update a view.");
+	}
+	if(Pk.size() != _npoints) {
+		throw RuntimeError("TabulatedPower::setValues: input vector has the wrong size.");
+	}
+	double *coefs = &_storage[_npoints];
+	for(int i = 0; i < _npoints; ++i) coefs[4*i] = Pk[i];
+	_fitSpline();
+	_fitExtrapolation(false);
+}
+
+void local::TabulatedPower::setLinearCombination(double a, TabulatedPower const &P1,
+double b, TabulatedPower const &P2) {
+	if(_owner) {
+		throw RuntimeError("TabulatedPower::setLinearCombination: cannot update a view.");
+	}
+	if(!hasSameGrid(P1) || !hasSameGrid(P2)) {
+		throw RuntimeError("TabulatedPower::setLinearCombination: k grids do not match.");
+	}
+	// Spline coefficients are linear in the tabulated values on a fixed grid.
+	double *coefs = &_storage[_npoints];
+	double const *c1 = P1._coefs, *c2 = P2._coefs;
+	int ncoefs(4*_npoints);
+	for(int i = 0; i < ncoefs; ++i) coefs[i] = a*c1[i] + b*c2[i];
+	_fitExtrapolation(false);
+}
+
+local::TabulatedPower::TabulatedPower(int npoints, double const *logk, double const *coefs,
+double kmin, double kmax, double invDlogk, double maxRelError,
+double const *below, double const *above, boost::shared_ptr<const void> owner) :
+_kmin(kmin), _kmax(kmax), _maxRelError(maxRelError), _npoints(npoints),
+_logk(logk), _coefs(coefs), _owner(owner), _invDlogk(invDlogk)
+{
+	if(below) _extrapolateBelow.reset(new PowerLawExtrapolator(below[0],below[1]));
+	if(above) _extrapolateAbove.reset(new PowerLawExtrapolator(above[0],above[1]));
+}
+
 local::TabulatedPower::~TabulatedPower() { }
 
+bool local::TabulatedPower::_getExtrapolation(bool above, double &a, double &c) const {
+	PowerLawExtrapolator const *extrapolator = above ?
+		_extrapolateAbove.get() : _extrapolateBelow.get();
+	if(!extrapolator) return false;
+	a = extrapolator->a;
+	c = extrapolator->c;
+	return true;
+}
+
 double local::TabulatedPower::operator()(double k) const {
 	// Return 0 without complaining if k <= 0
 	if(k <= 0) return 0;
@@ -128,21 +258,81 @@ double local::TabulatedPower::operator()(double k) const {
 	else {
 		// We must have kmin <= k <= kmax so interpolate in log(k)
 		double logk = std::log(k);
-		return (*_interpolator)(logk);
+		int j = _getSegment(logk);
+		double t(logk - _logk[j]);
+		double const *c = &_coefs[4*j];
+		return c[0] + t*(c[1] + t*(c[2] + t*c[3]));
+	}
+}
+
+int local::TabulatedPower::_getSegment(double logk) const {
+	int nseg(_npoints-1);
+	if(_invDlogk > 0) {
+		// Calculate the segment directly, then correct for small deviations of the
+		// tabulated values from uniform spacing.
+		int j = (int)((logk - _logk[0])*_invDlogk);
+		if(j < 0) j = 0;
+		else if(j > nseg-1) j = nseg-1;
+		if(logk < _logk[j] && j > 0) --j;
+		else if(logk > _logk[j+1] && j < nseg-1) ++j;
+		return j;
+	}
+	int j = std::upper_bound(_logk,_logk+_npoints,logk) - _logk - 1;
+	return (j > nseg-1) ? nseg-1 : j;
+}
+
+void local::TabulatedPower::evaluateLogGrid(double logk0, double dlogk,
+std::vector<double> &result) const {
+	int n(result.size()), nseg(_npoints-1);
+	double logkMin(_logk[0]), logkMax(_logk[nseg]);
+	double const *logk = _logk;
+	// Start from the segment at the end of our tabulation where the walk begins.
+	int j = (dlogk >= 0) ? 0 : nseg-1;
+	for(int i = 0; i < n; ++i) {
+		double lk = logk0 + i*dlogk;
+		if(lk < logkMin) {
+			if(!_extrapolateBelow) {
+				throw RuntimeError("TabulatedPower: extrapolation below kmin not enabled.");
+			}
+			result[i] = (*_extrapolateBelow)(std::exp(lk));
+			continue;
+		}
+		if(lk > logkMax) {
+			if(!_extrapolateAbove) {
+				throw RuntimeError("TabulatedPower: extrapolation above kmax not enabled.");
+			}
+			result[i] = (*_extrapolateAbove)(std::exp(lk));
+			continue;
+		}
+		// Walk to the segment [j,j+1] containing lk
+		if(dlogk >= 0) {
+			while(j < nseg-1 && lk > logk[j+1]) ++j;
+		}
+		else {
+			while(j > 0 && lk < logk[j]) --j;
+		}
+		double t(lk - logk[j]);
+		double const *c = &_coefs[4*j];
+		result[i] = c[0] + t*(c[1] + t*(c[2] + t*c[3]));
 	}
 }
 
 local::TabulatedPowerCPtr local::TabulatedPower::createDelta(
 TabulatedPowerCPtr other, bool verbose) const {
-	likely::Interpolator::CoordinateValues logkGrid = _interpolator->getXGrid();
-	likely::Interpolator::CoordinateValues deltaGrid = _interpolator->getYGrid();
-	likely::Interpolator::CoordinateValues kGrid;
-	int n(logkGrid.size());
+	if(hasSameGrid(*other)) {
+		// Combine our spline coefficients directly without refitting
+		TabulatedPowerPtr delta(new TabulatedPower(*this));
+		delta->setLinearCombination(1,*this,-1,*other);
+		return delta;
+	}
+	int n(_npoints);
+	std::vector<double> kGrid, deltaGrid;
 	kGrid.reserve(n);
+	deltaGrid.reserve(n);
 	for(int i = 0; i < n; ++i) {
-		double k = std::exp(logkGrid[i]);
+		double k = std::exp(_logk[i]);
 		kGrid.push_back(k);
-		deltaGrid[i] -= (*other)(k);
+		deltaGrid.push_back(_coefs[4*i] - (*other)(k));
 	}
 	bool extrapolateBelow(!!_extrapolateBelow), extrapolateAbove(!!_extrapolateAbove);
 	TabulatedPowerCPtr delta(new TabulatedPower(kGrid,deltaGrid,
@@ -150,6 +340,13 @@ TabulatedPowerCPtr other, bool verbose) const {
 	return delta;
 }
 
+local::TabulatedPowerCPtr local::createLinearCombination(double a, TabulatedPowerCPtr P1,
+double b, TabulatedPowerCPtr P2) {
+	TabulatedPowerPtr combined(new TabulatedPower(*P1));
+	combined->setLinearCombination(a,*P1,b,*P2);
+	return combined;
+}
+
 local::TabulatedPowerCPtr local::createTabulatedPower(std::string const &filename,
 bool extrapolateBelow, bool extrapolateAbove, double maxRelError, bool verbose)
 {
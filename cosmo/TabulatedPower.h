@@ -9,13 +9,15 @@
 #include "boost/smart_ptr.hpp"
 
 #include <iosfwd>
+#include <vector>
 
 namespace cosmo {
 	class TabulatedPower {
 	// Represents a power spectrum P(k) derived from tabulated values of P(k) that
 	// are assumed (but not required) to be (approximately) logarithmically spaced
 	// in k. Supports optional power-law extrapolation above and below the limits
-	// of the tabulated range of k.
+	// of the tabulated range of k. When the tabulated k values are logarithmically
+	// spaced, the spline segment containing any k is found in constant time.
 	public:
 		// Creates a new tabulated power object using the specified vectors of k
 		// and P(k) which must be of the same size, with k > 0 and increasing.
@@ -28,28 +30,81 @@ namespace cosmo {
 		TabulatedPower(std::vector<double> const &k, std::vector<double> const &Pk,
 			bool extrapolateBelow = false, bool extrapolateAbove = false,
 			double maxRelError = 1e-3, bool verbose = false);
+		// Creates a copy of another tabulated power that owns its own tabulated values
+		// and spline coefficients (even if other is a view into a TabulatedPowerArchive).
+		TabulatedPower(TabulatedPower const &other);
 		virtual ~TabulatedPower();
 		// Evaluates P(k) for the specified k. Always returns 0 for k <= 0.
 		double operator()(double k) const;
+		// Evaluates P(k) at the n = result.size() logarithmically spaced points k[i] with
+		// log(k[i]) = logk0 + i*dlogk, where dlogk can be positive or negative. Gives the
+		// same results as operator() (up to roundoff) but walks the spline segments
+		// incrementally, so avoids a log(k) and a binary search for each point.
+		void evaluateLogGrid(double logk0, double dlogk, std::vector<double> &result) const;
 		// Returns the interpolation limits
 		double getKMin() const;
 		double getKMax() const;
+		// Returns true if our tabulated k values are logarithmically spaced.
+		bool isLogUniform() const;
 		// Creates a new tabulated power object for the difference between this power
 		// and another power. In case the other power is tabulated on a different k grid,
 		// our grid will be used for the result. Uses the same options to create the new
 		// object that we were created with. The returned object has no dependencies on
 		// this object or the other object.
+		// When the other power uses the same k grid, the result is calculated directly
+		// from our spline coefficients, without evaluating other or refitting a spline.
 		TabulatedPowerCPtr createDelta(TabulatedPowerCPtr other, bool verbose = false) const;
+		// Returns true if the other power is tabulated at the same k values as us.
+		bool hasSameGrid(TabulatedPower const &other) const;
+		// The following methods update our tabulated values in place, reusing our existing
+		// storage so that no memory is allocated, and refit our power-law extrapolations
+		// (throwing a RuntimeError if they are no longer sufficiently accurate). They cannot
+		// be used with a view into a TabulatedPowerArchive and are not safe to call while
+		// other threads are evaluating this object. Sets new values of P(k) on our k grid:
+		void setValues(std::vector<double> const &Pk);
+		// Sets our values to a*P1 + b*P2, where P1 and P2 must have the same k grid as us
+		// (either can be this object). Since spline coefficients are linear in the tabulated
+		// values, this combines the spline coefficients directly in O(n) without refitting.
+		void setLinearCombination(double a, TabulatedPower const &P1,
+			double b, TabulatedPower const &P2);
 
 	private:
+		// Creates a view of tabulated values and spline coefficients owned by another
+		// object, which we keep alive (see TabulatedPowerArchive). The below and above
+		// extrapolation parameters are the (a,c) of P(k) = c*k^a, or zero if not enabled.
+		TabulatedPower(int npoints, double const *logk, double const *coefs,
+			double kmin, double kmax, double invDlogk, double maxRelError,
+			double const *below, double const *above, boost::shared_ptr<const void> owner);
+		friend class TabulatedPowerArchive;
 		double _kmin, _kmax, _maxRelError;
 		class PowerLawExtrapolator;
 		boost::scoped_ptr<PowerLawExtrapolator> _extrapolateBelow, _extrapolateAbove;
-		likely::InterpolatorPtr _interpolator;
+		// Tabulated log(k) values and the natural cubic spline coefficients of P(k) in
+		// t = log(k) - _logk[j] for each segment j, packed 4 per tabulated point so that
+		// _coefs[4*j] = P(k[j]) (the last point has only this constant term). These
+		// point into _storage, or into memory kept alive by _owner for a view.
+		int _npoints;
+		double const *_logk, *_coefs;
+		std::vector<double> _storage;
+		boost::shared_ptr<const void> _owner;
+		// Inverse spacing of log(k), or zero if our k values are not log uniform.
+		double _invDlogk;
+		int _getSegment(double logk) const;
+		void _fitSpline();
+		void _fitExtrapolation(bool verbose);
+		// Returns true and sets the parameters of P(k) = c*k^a if extrapolation
+		// above (or below) our tabulated range is enabled.
+		bool _getExtrapolation(bool above, double &a, double &c) const;
 	}; // TabulatedPower
 
 	inline double TabulatedPower::getKMin() const { return _kmin; }
 	inline double TabulatedPower::getKMax() const { return _kmax; }
+	inline bool TabulatedPower::isLogUniform() const { return _invDlogk > 0; }
+
+	// Creates a new tabulated power a*P1 + b*P2 from two tabulated powers with the same
+	// k grid, using the extrapolation options of P1. See setLinearCombination above.
+	TabulatedPowerCPtr createLinearCombination(double a, TabulatedPowerCPtr P1,
+		double b, TabulatedPowerCPtr P2);
 
 	// Creates a new tabulated power object using k and P(k) vectors read from
 	// the specified filename. Additional options are as described above.
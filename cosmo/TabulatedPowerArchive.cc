@@ -0,0 +1,247 @@
+// Created 18-Oct-2026
+
+#include "cosmo/TabulatedPowerArchive.h"
+#include "cosmo/TabulatedPower.h"
+#include "cosmo/RuntimeError.h"
+
+#include "boost/cstdint.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace local = cosmo;
+
+// An archive file consists of a fixed-size header, followed by one fixed-size entry
+// for each spectrum, then the concatenated spectrum names and finally the data for each
+// spectrum: npoints values of log(k) followed by 4*npoints spline coefficients (see
+// TabulatedPower). All offsets are in bytes from the start of the file and all data
+// offsets are multiples of 8 bytes.
+namespace cosmo {
+	namespace archive {
+		char const magic[8] = { 'C','O','S','M','O','T','P','A' };
+		boost::uint64_t const version = 1;
+		struct Header {
+			char magic[8];
+			boost::uint64_t version, count, reserved;
+		};
+		enum Flags { ExtrapolateBelow = 1, ExtrapolateAbove = 2 };
+		struct Entry {
+			boost::uint64_t nameOffset, nameLength, dataOffset, npoints, flags;
+			double kmin, kmax, maxRelError, invDlogk;
+			double below[2], above[2];
+		};
+	} // archive
+} // cosmo
+
+class local::TabulatedPowerArchive::Mapping {
+public:
+	Mapping(std::string const &filename) {
+		int fd = ::open(filename.c_str(),O_RDONLY);
+		if(fd < 0) {
+			throw RuntimeError("TabulatedPowerArchive: unable to open " + filename);
+		}
+		struct stat info;
+		if(::fstat(fd,&info) != 0) {
+			::close(fd);
+			throw RuntimeError("TabulatedPowerArchive: unable to stat " + filename);
+		}
+		size = info.st_size;
+		if(size < sizeof(archive::Header)) {
+			::close(fd);
+			throw RuntimeError("TabulatedPowerArchive: file is too small.");
+		}
+		void *addr = ::mmap(0,size,PROT_READ,MAP_SHARED,fd,0);
+		// The mapping remains valid after the file is closed.
+		::close(fd);
+		if(addr == MAP_FAILED) {
+			throw RuntimeError("TabulatedPowerArchive: unable to map " + filename);
+		}
+		base = static_cast<char const*>(addr);
+	}
+	~Mapping() {
+		::munmap(const_cast<char*>(base),size);
+	}
+	char const *base;
+	std::size_t size;
+};
+
+local::TabulatedPowerArchive::TabulatedPowerArchive(std::string const &filename)
+: _mapping(new Mapping(filename))
+{
+	archive::Header const *header = reinterpret_cast<archive::Header const*>(_mapping->base);
+	if(std::memcmp(header->magic,archive::magic,sizeof(archive::magic)) != 0) {
+		throw RuntimeError("TabulatedPowerArchive: not an archive file.");
+	}
+	if(header->version != archive::version) {
+		throw RuntimeError("TabulatedPowerArchive: unsupported archive version.");
+	}
+	// The checks below are written so that corrupted 64-bit values cannot overflow. The
+	// mapping is at least as large as the header.
+	boost::uint64_t count(header->count), size(_mapping->size);
+	if(count > (size - sizeof(archive::Header))/sizeof(archive::Entry)) {
+		throw RuntimeError("TabulatedPowerArchive: archive is truncated.");
+	}
+	// Read and index the spectrum names, checking that each entry lies within the file.
+	archive::Entry const *entries = reinterpret_cast<archive::Entry const*>(header+1);
+	_names.reserve(count);
+	for(int index = 0; index < count; ++index) {
+		archive::Entry const &entry = entries[index];
+		if(entry.nameOffset > size || entry.nameLength > size - entry.nameOffset ||
+			entry.npoints < 3 || entry.npoints > INT_MAX ||
+			entry.dataOffset % sizeof(double) != 0 || entry.dataOffset > size ||
+			entry.npoints > (size - entry.dataOffset)/(5*sizeof(double))) {
+			throw RuntimeError("TabulatedPowerArchive: archive is corrupted.");
+		}
+		_names.push_back(std::string(_mapping->base + entry.nameOffset,entry.nameLength));
+		_index[_names.back()] = index;
+	}
+}
+
+local::TabulatedPowerArchive::~TabulatedPowerArchive() { }
+
+std::string const &local::TabulatedPowerArchive::getName(int index) const {
+	if(index < 0 || index >= _names.size()) {
+		throw RuntimeError("TabulatedPowerArchive::getName: invalid index.");
+	}
+	return _names[index];
+}
+
+local::TabulatedPowerCPtr local::TabulatedPowerArchive::getPower(int index) const {
+	if(index < 0 || index >= _names.size()) {
+		throw RuntimeError("TabulatedPowerArchive::getPower: invalid index.");
+	}
+	archive::Entry const &entry =
+		reinterpret_cast<archive::Entry const*>(_mapping->base + sizeof(archive::Header))[index];
+	double const *logk = reinterpret_cast<double const*>(_mapping->base + entry.dataOffset);
+	int npoints(entry.npoints);
+	// TabulatedPower relies on the tabulated log(k) values being increasing and consistent
+	// with the other entry fields, so check them here (the constructor only checks that
+	// each entry lies within the file). The negated comparisons also reject NaN values.
+	for(int i = 1; i < npoints; ++i) {
+		if(!(logk[i] > logk[i-1])) {
+			throw RuntimeError("TabulatedPowerArchive::getPower: log(k) values are not increasing.");
+		}
+	}
+	if(!(std::fabs(entry.kmin - std::exp(logk[0])) <= 1e-12*entry.kmin) ||
+		!(std::fabs(entry.kmax - std::exp(logk[npoints-1])) <= 1e-12*entry.kmax)) {
+		throw RuntimeError("TabulatedPowerArchive::getPower: kmin,kmax do not match log(k) values.");
+	}
+	if(entry.invDlogk != 0 && !(std::fabs(entry.invDlogk*(logk[npoints-1]-logk[0]) - (npoints-1))
+		<= 1e-6*(npoints-1))) {
+		throw RuntimeError("TabulatedPowerArchive::getPower: invalid log(k) spacing.");
+	}
+	TabulatedPowerCPtr power(new TabulatedPower(npoints,logk,logk+npoints,
+		entry.kmin,entry.kmax,entry.invDlogk,entry.maxRelError,
+		(entry.flags & archive::ExtrapolateBelow) ? entry.below : 0,
+		(entry.flags & archive::ExtrapolateAbove) ? entry.above : 0,
+		_mapping));
+	return power;
+}
+
+local::TabulatedPowerCPtr local::TabulatedPowerArchive::getPower(std::string const &name) const {
+	std::map<std::string,int>::const_iterator found = _index.find(name);
+	if(found == _index.end()) {
+		throw RuntimeError("TabulatedPowerArchive::getPower: no spectrum named " + name);
+	}
+	return getPower(found->second);
+}
+
+void local::TabulatedPowerArchive::write(std::string const &filename,
+std::vector<std::string> const &names, std::vector<TabulatedPowerCPtr> const &powers) {
+	int count(names.size());
+	if(powers.size() != count) {
+		throw RuntimeError("TabulatedPowerArchive::write: names and powers have different sizes.");
+	}
+	if(std::set<std::string>(names.begin(),names.end()).size() != count) {
+		throw RuntimeError("TabulatedPowerArchive::write: names are not unique.");
+	}
+	// Build the header and entries, and calculate the offset of each spectrum's data.
+	archive::Header header;
+	std::memcpy(header.magic,archive::magic,sizeof(archive::magic));
+	header.version = archive::version;
+	header.count = count;
+	header.reserved = 0;
+	std::vector<archive::Entry> entries(count);
+	boost::uint64_t offset = sizeof(archive::Header) + count*sizeof(archive::Entry);
+	for(int index = 0; index < count; ++index) {
+		entries[index].nameOffset = offset;
+		entries[index].nameLength = names[index].size();
+		offset += names[index].size();
+	}
+	// Pad the names to a multiple of 8 bytes
+	int padding = (sizeof(double) - offset%sizeof(double))%sizeof(double);
+	offset += padding;
+	for(int index = 0; index < count; ++index) {
+		TabulatedPower const &power = *powers[index];
+		archive::Entry &entry = entries[index];
+		entry.dataOffset = offset;
+		entry.npoints = power._npoints;
+		entry.kmin = power._kmin;
+		entry.kmax = power._kmax;
+		entry.maxRelError = power._maxRelError;
+		entry.invDlogk = power._invDlogk;
+		entry.flags = 0;
+		entry.below[0] = entry.below[1] = entry.above[0] = entry.above[1] = 0;
+		if(power._getExtrapolation(false,entry.below[0],entry.below[1])) {
+			entry.flags |= archive::ExtrapolateBelow;
+		}
+		if(power._getExtrapolation(true,entry.above[0],entry.above[1])) {
+			entry.flags |= archive::ExtrapolateAbove;
+		}
+		offset += 5*entry.npoints*sizeof(double);
+	}
+	// Write to a new temporary file in the same directory and then rename it over filename,
+	// so that views into an existing archive, which map its file, are never truncated or
+	// modified (and readers always see either the old or the new archive).
+	std::string tmpname(filename + ".XXXXXX");
+	int fd = ::mkstemp(&tmpname[0]);
+	if(fd < 0) {
+		throw RuntimeError("TabulatedPowerArchive::write: unable to create a temporary file for "
+			+ filename);
+	}
+	// mkstemp uses mode 0600, so keep the mode of any file we are replacing instead.
+	struct stat info;
+	mode_t mode = (::stat(filename.c_str(),&info) == 0) ?
+		(info.st_mode & 07777) : (S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	::fchmod(fd,mode);
+	::close(fd);
+	std::ofstream out(tmpname.c_str(),std::ios::binary|std::ios::trunc);
+	if(!out) {
+		::unlink(tmpname.c_str());
+		throw RuntimeError("TabulatedPowerArchive::write: unable to open " + tmpname);
+	}
+	out.write(reinterpret_cast<char const*>(&header),sizeof(header));
+	if(count > 0) {
+		out.write(reinterpret_cast<char const*>(&entries[0]),count*sizeof(archive::Entry));
+	}
+	for(int index = 0; index < count; ++index) {
+		out.write(names[index].data(),names[index].size());
+	}
+	char const zeros[sizeof(double)] = { 0 };
+	out.write(zeros,padding);
+	for(int index = 0; index < count; ++index) {
+		TabulatedPower const &power = *powers[index];
+		out.write(reinterpret_cast<char const*>(power._logk),power._npoints*sizeof(double));
+		out.write(reinterpret_cast<char const*>(power._coefs),4*power._npoints*sizeof(double));
+	}
+	out.close();
+	if(!out) {
+		::unlink(tmpname.c_str());
+		throw RuntimeError("TabulatedPowerArchive::write: error writing " + filename);
+	}
+	if(std::rename(tmpname.c_str(),filename.c_str()) != 0) {
+		::unlink(tmpname.c_str());
+		throw RuntimeError("TabulatedPowerArchive::write: unable to replace " + filename);
+	}
+}
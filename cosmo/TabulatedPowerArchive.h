@@ -0,0 +1,56 @@
+// Created 18-Oct-2026
+
+#ifndef COSMO_TABULATED_POWER_ARCHIVE
+#define COSMO_TABULATED_POWER_ARCHIVE
+
+#include "cosmo/types.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace cosmo {
+	class TabulatedPowerArchive {
+	// Provides read-only access to many named tabulated power spectra stored in a single
+	// binary file, which is memory mapped so that opening an archive does not read or
+	// parse its contents. Each spectrum is stored with its precomputed spline coefficients
+	// and extrapolation parameters, so the TabulatedPower objects returned by getPower()
+	// are views into the mapped file that do not copy any tabulated values or refit any
+	// splines. These views remain valid after the archive object is deleted. Archives
+	// use the native byte order and are not portable between different architectures.
+	public:
+		// Opens and memory maps the specified archive file.
+		TabulatedPowerArchive(std::string const &filename);
+		virtual ~TabulatedPowerArchive();
+		// Returns the number of spectra in this archive.
+		int getNumSpectra() const;
+		// Returns the name of the spectrum with the specified index.
+		std::string const &getName(int index) const;
+		// Returns true if this archive contains a spectrum with the specified name.
+		bool hasPower(std::string const &name) const;
+		// Returns the spectrum with the specified index or name, or throws a RuntimeError.
+		// Each call checks the tabulated log(k) values of the spectrum (which the
+		// constructor does not read), and throws a RuntimeError if they are corrupted.
+		TabulatedPowerCPtr getPower(int index) const;
+		TabulatedPowerCPtr getPower(std::string const &name) const;
+		// Writes a new archive containing the specified named spectra to filename,
+		// replacing any existing file. Names must be unique. The archive is written to a
+		// temporary file in the same directory that is then renamed to filename, so any
+		// views into an existing archive with this filename are not affected.
+		static void write(std::string const &filename, std::vector<std::string> const &names,
+			std::vector<TabulatedPowerCPtr> const &powers);
+	private:
+		class Mapping;
+		boost::shared_ptr<const Mapping> _mapping;
+		std::vector<std::string> _names;
+		std::map<std::string,int> _index;
+	}; // TabulatedPowerArchive
+
+	inline int TabulatedPowerArchive::getNumSpectra() const { return _names.size(); }
+	inline bool TabulatedPowerArchive::hasPower(std::string const &name) const {
+		return _index.count(name) > 0;
+	}
+
+} // cosmo
+
+#endif // COSMO_TABULATED_POWER_ARCHIVE
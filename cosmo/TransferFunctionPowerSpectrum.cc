@@ -15,7 +15,7 @@ namespace local = cosmo;
 
 local::TransferFunctionPowerSpectrum::TransferFunctionPowerSpectrum(
 TransferFunctionPtr transferFunction, double spectralIndex, double deltaH)
-: _transferFunction(transferFunction)
+: _transferFunction(transferFunction), _sigmaRMpch(0), _sigmaGaussian(false)
 {
     setSpectralIndex(spectralIndex);
     setDeltaH(deltaH);
@@ -43,14 +43,64 @@ double local::TransferFunctionPowerSpectrum::operator()(double kMpch) const {
 }
 
 double local::TransferFunctionPowerSpectrum::setSigma(double sigma, double rMpch, bool gaussian) {
-    PowerSpectrumPtr self(new cosmo::PowerSpectrum(boost::ref(*this)));
-    double sigmaOld = getRmsAmplitude(self, rMpch, gaussian);
+    double sigmaOld = getSigma(rMpch, gaussian);
     double ratio(sigma/sigmaOld);
     _deltaH *= ratio;
     _deltaHSq = _deltaH*_deltaH;
     return sigmaOld;
 }
 
+double local::TransferFunctionPowerSpectrum::getSigma(double rMpch, bool gaussian,
+double *dSigmaDn) const {
+    if(_sigmaWeight.empty() || rMpch != _sigmaRMpch || gaussian != _sigmaGaussian) {
+        if(dSigmaDn) {
+            throw RuntimeError("TransferFunctionPowerSpectrum::getSigma: dSigmaDn requires prepareSigma.");
+        }
+        PowerSpectrumPtr self(new cosmo::PowerSpectrum(boost::cref(*this)));
+        return getRmsAmplitude(self, rMpch, gaussian);
+    }
+    // sigma^2 = deltaH^2 Sum[ w(i) y(i)^(3+n) ] over our quadrature nodes
+    int nk(_sigmaLogY.size());
+    double power(3+_spectralIndex), sum0(0), sum1(0);
+    for(int i = 0; i < nk; ++i) {
+        double term = _sigmaWeight[i]*std::exp(power*_sigmaLogY[i]);
+        sum0 += term;
+        sum1 += term*_sigmaLogY[i];
+    }
+    double sigma = _deltaH*std::sqrt(sum0);
+    if(dSigmaDn) *dSigmaDn = sigma*sum1/(2*sum0);
+    return sigma;
+}
+
+void local::TransferFunctionPowerSpectrum::prepareSigma(double rMpch, bool gaussian,
+int samplesPerDecade) {
+    if(rMpch <= 0) {
+        throw RuntimeError("TransferFunctionPowerSpectrum::prepareSigma: expected rMpch > 0.");
+    }
+    if(samplesPerDecade < 2) {
+        throw RuntimeError("TransferFunctionPowerSpectrum::prepareSigma: expected samplesPerDecade >= 2.");
+    }
+    // Use Simpson's rule in log(k) with an even number of intervals covering
+    // 1e-4 < k*rMpch < 1e3.
+    double logkrMin(std::log(1e-4)), logkrMax(std::log(1e3));
+    int nint = 7*samplesPerDecade;
+    if(nint % 2) ++nint;
+    double dlogk = (logkrMax - logkrMin)/nint;
+    std::vector<double>(nint+1).swap(_sigmaLogY);
+    std::vector<double>(nint+1).swap(_sigmaWeight);
+    for(int i = 0; i <= nint; ++i) {
+        double kr = std::exp(logkrMin + i*dlogk), kMpch(kr/rMpch), kr2(kr*kr);
+        double wgt(gaussian ?
+            std::exp(-kr2/2) : (std::sin(kr)-kr*std::cos(kr))*3/(kr2*kr));
+        double Tf((*_transferFunction)(kMpch));
+        double simpson = (0 == i || nint == i) ? 1 : ((i % 2) ? 4 : 2);
+        _sigmaLogY[i] = std::log(kMpch*hubbleLength());
+        _sigmaWeight[i] = simpson*dlogk/3*Tf*Tf*wgt*wgt;
+    }
+    _sigmaRMpch = rMpch;
+    _sigmaGaussian = gaussian;
+}
+
 namespace cosmo {
     class RmsIntegrand {
     public:
@@ -82,16 +132,28 @@ double local::legendreP(int ell, double mu) {
     switch(ell) {
         case 0:
         return 1;
+        case 1:
+        return mu;
         case 2:
         return (-1+mu2*3)/2;
+        case 3:
+        return mu*(-3+mu2*5)/2;
         case 4:
         return (3-mu2*(30-mu2*35))/8;
+        case 5:
+        return mu*(15-mu2*(70-mu2*63))/8;
         case 6:
         return (-5+mu2*(105-mu2*(315-mu2*231)))/16;
+        case 7:
+        return mu*(-35+mu2*(315-mu2*(693-mu2*429)))/16;
         case 8:
         return (35-mu2*(1260-mu2*(6930-mu2*(12012-mu2*6435))))/128;
+        case 9:
+        return mu*(315-mu2*(4620-mu2*(18018-mu2*(25740-mu2*12155))))/128;
         case 10:
         return (-63+mu2*(3465-mu2*(30030-mu2*(90090-mu2*(109395-mu2*46189)))))/256;
+        case 11:
+        return mu*(-693+mu2*(15015-mu2*(90090-mu2*(218790-mu2*(230945-mu2*88179)))))/256;
         case 12:
         return (231-mu2*(18018-mu2*(225225-mu2*(1021020-mu2*(2078505-mu2*(1939938-mu2*676039))))))/1024;
         default:
@@ -104,7 +166,7 @@ namespace cosmo {
     public:
         MultipoleIntegrand(likely::GenericFunctionPtr fOfMuPtr, int ell)
         : _fOfMuPtr(fOfMuPtr), _ell(ell) {
-            if(ell < 0 || ell % 2 == 1) throw RuntimeError("MultipoleIntegrand: invalid ell.");
+            if(ell < 0) throw RuntimeError("MultipoleIntegrand: invalid ell.");
             if(ell > 12) throw RuntimeError("MultipoleIntegrand: ell > 12 not implemented yet.");
             _norm = 0.5*(2*ell+1);
         }
@@ -119,15 +181,51 @@ namespace cosmo {
     };
 } // cosmo::
 
-double local::getMultipole(likely::GenericFunctionPtr fOfMuPtr, int ell, double epsAbs, double epsRel) {
+double local::getMultipole(likely::GenericFunctionPtr fOfMuPtr, int ell, double epsAbs, double epsRel,
+bool symmetric) {
     MultipoleIntegrand multipoleIntegrand(fOfMuPtr,ell);
+    // Odd multipoles of a symmetric function vanish
+    if(symmetric && (ell % 2 == 1)) return 0;
     likely::Integrator::IntegrandPtr integrand(new likely::Integrator::Integrand(
         boost::ref(multipoleIntegrand)));
     likely::Integrator integrator(integrand,epsAbs,epsRel);
+    if(!symmetric) return integrator.integrateSmooth(-1,1);
     // Factor of two is because we integrate over 0 < mu < 1 instead of -1 < mu < +1.
     return 2*integrator.integrateSmooth(0,1);
 }
 
+void local::getGaussLegendreRule(int n, std::vector<double> &nodes, std::vector<double> &weights,
+double a, double b) {
+    if(n < 1) throw RuntimeError("getGaussLegendreRule: expected n >= 1.");
+    if(b <= a) throw RuntimeError("getGaussLegendreRule: expected a < b.");
+    std::vector<double>(n).swap(nodes);
+    std::vector<double>(n).swap(weights);
+    double pi(4*std::atan(1)), mid(0.5*(a+b)), half(0.5*(b-a));
+    // Find the roots of P_n(x) on [-1,1] by Newton iteration, using the symmetry x -> -x
+    int nroots = (n+1)/2;
+    for(int i = 0; i < nroots; ++i) {
+        double x = std::cos(pi*(i+0.75)/(n+0.5)), dp(0);
+        for(int iter = 0; iter < 100; ++iter) {
+            // Evaluate P_n(x) and P_n'(x) using the upward recurrence
+            double p0(1), p1(x);
+            for(int j = 2; j <= n; ++j) {
+                double p2 = ((2*j-1)*x*p1 - (j-1)*p0)/j;
+                p0 = p1;
+                p1 = p2;
+            }
+            dp = n*(x*p1 - p0)/(x*x - 1);
+            double dx = p1/dp;
+            x -= dx;
+            if(std::fabs(dx) < 1e-15) break;
+        }
+        double w = 2/((1 - x*x)*dp*dp);
+        // Nodes are stored in increasing order
+        nodes[i] = mid - half*x;
+        nodes[n-1-i] = mid + half*x;
+        weights[i] = weights[n-1-i] = half*w;
+    }
+}
+
 // explicit template instantiation for creating a function pointer to a TransferFunctionPowerSpectrum.
 
 #include "likely/function_impl.h"
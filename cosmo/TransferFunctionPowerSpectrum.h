@@ -10,6 +10,8 @@
 #include "boost/function.hpp"
 #include "boost/smart_ptr.hpp"
 
+#include <vector>
+
 namespace cosmo {
     // Represents an isotropic power spectrum of 3D inhomogeneities based on a model of
     // primordial fluctuations and a transfer function.
@@ -32,10 +34,34 @@ namespace cosmo {
         // specified radius. Otherwise, a step function (top-hat) window function is
         // used. The default values of rMpch = 8 and gaussian = false correspond to the
         // usual definition of sigma8.
+        // If prepareSigma() has been called with the same rMpch and gaussian values,
+        // uses its fixed quadrature instead of an adaptive integration.
         double setSigma(double sigma, double rMpch = 8, bool gaussian = false);
+        // Returns the RMS amplitude sigma of fluctuations within a radius of rMpch for
+        // our current deltaH and spectralIndex. See setSigma for the meaning of gaussian.
+        // Uses a fixed quadrature if prepareSigma() has been called with the same rMpch
+        // and gaussian values, or else an adaptive integration (see getRmsAmplitude).
+        // If dSigmaDn is not null, it is set to the derivative of sigma with respect to
+        // spectralIndex, which requires a prepared quadrature. Note that the derivative
+        // with respect to deltaH is simply sigma/deltaH.
+        double getSigma(double rMpch = 8, bool gaussian = false, double *dSigmaDn = 0) const;
+        // Prepares a fixed quadrature in log(k) for calculating sigma within a radius of
+        // rMpch by tabulating T(k)^2 times the window function at the specified number of
+        // samples per decade, covering 1e-4 < k*rMpch < 1e3. Subsequent calls to getSigma
+        // and setSigma with the same radius and window are then a sum over the tabulated
+        // weights, for any deltaH and spectralIndex, without evaluating the transfer function.
+        // The tabulated weights are only valid as long as the transfer function is unchanged.
+        // With the default samplesPerDecade and an EH98 transfer function, sigma8 agrees with
+        // the adaptive integration to better than 1e-6 (relative) for 0.8 < spectralIndex < 1.2.
+        void prepareSigma(double rMpch = 8, bool gaussian = false, int samplesPerDecade = 100);
 	private:
         TransferFunctionPtr _transferFunction;
         double _spectralIndex, _deltaH, _deltaHSq;
+        // Fixed quadrature prepared for sigma: log(k*hubbleLength) at each node and the
+        // corresponding weight times T(k)^2 times the squared window function.
+        double _sigmaRMpch;
+        bool _sigmaGaussian;
+        std::vector<double> _sigmaLogY, _sigmaWeight;
 	}; // TransferFunctionPowerSpectrum
 	
     inline double TransferFunctionPowerSpectrum::getSpectralIndex() const { return _spectralIndex; }
@@ -50,12 +76,19 @@ namespace cosmo {
     double getRmsAmplitude(PowerSpectrumPtr powerSpectrum, double rMpch,
         bool gaussian = false);
 	
-	// Evaluates the Legendre polynomial for even ell up to 12 and returns 0 for any other ell.
+	// Evaluates the Legendre polynomial for ell up to 12 and returns 0 for any other ell.
     double legendreP(int ell, double mu);
 
     // Returns the specified multipole projection of the function provided, calculated
-    // using numerical integration over 0 < mu < 1. Only even 0 <= ell <= 12 are implemented.
-    double getMultipole(likely::GenericFunctionPtr fOfMuPtr, int ell, double epsAbs = 1e-6, double epsRel = 1e-6);
+    // using numerical integration over 0 < mu < 1 if symmetric is true (in which case odd
+    // multipoles are zero), or else over -1 < mu < 1. Only 0 <= ell <= 12 are implemented.
+    double getMultipole(likely::GenericFunctionPtr fOfMuPtr, int ell, double epsAbs = 1e-6, double epsRel = 1e-6,
+        bool symmetric = true);
+
+    // Fills the vectors provided with the nodes and weights of the n-point Gauss-Legendre
+    // quadrature rule on [a,b], which is exact for polynomials of degree up to 2n-1.
+    void getGaussLegendreRule(int n, std::vector<double> &nodes, std::vector<double> &weights,
+        double a = -1, double b = 1);
 	
 } // cosmo
 
@@ -12,14 +12,24 @@
 #include "cosmo/BaryonPerturbations.h"
 #include "cosmo/BroadbandPower.h"
 
+#include "cosmo/NaturalSpline.h"
 #include "cosmo/TabulatedPower.h"
+#include "cosmo/TabulatedPowerArchive.h"
 #include "cosmo/TransferFunctionPowerSpectrum.h"
 #include "cosmo/PowerSpectrumCorrelationFunction.h"
 #include "cosmo/OneDimensionalPowerSpectrum.h"
 #include "cosmo/RsdCorrelationFunction.h"
+#include "cosmo/AbsMultipoleTransform.h"
 #include "cosmo/MultipoleTransform.h"
+#include "cosmo/FftLogTransform.h"
 #include "cosmo/AdaptiveMultipoleTransform.h"
+#include "cosmo/BatchMultipoleTransform.h"
 #include "cosmo/DistortedPowerCorrelation.h"
+#include "cosmo/CorrelationSnapshot.h"
+#include "cosmo/Instrumentation.h"
+#include "cosmo/SeparableDistortedPowerCorrelation.h"
+#include "cosmo/CorrelationProjector.h"
+#include "cosmo/BinnedCorrelationProjector.h"
 #include "cosmo/DistortedPowerCorrelationFft.h"
 
 #include "cosmo/AbsGaussianRandomFieldGenerator.h"
@@ -20,8 +20,12 @@ namespace cosmo {
     typedef boost::shared_ptr<AbsGaussianRandomFieldGenerator> AbsGaussianRandomFieldGeneratorPtr;
 
     class TabulatedPower;
+    typedef boost::shared_ptr<TabulatedPower> TabulatedPowerPtr;
     typedef boost::shared_ptr<const TabulatedPower> TabulatedPowerCPtr;
 
+    class TabulatedPowerArchive;
+    typedef boost::shared_ptr<const TabulatedPowerArchive> TabulatedPowerArchiveCPtr;
+
     class AdaptiveMultipoleTransform;
     typedef boost::shared_ptr<AdaptiveMultipoleTransform> AdaptiveMultipoleTransformPtr;
     typedef boost::shared_ptr<const AdaptiveMultipoleTransform> AdaptiveMultipoleTransformCPtr;
@@ -29,6 +33,13 @@ namespace cosmo {
     class DistortedPowerCorrelation;
     typedef boost::shared_ptr<DistortedPowerCorrelation> DistortedPowerCorrelationPtr;
     typedef boost::shared_ptr<const DistortedPowerCorrelation> DistortedPowerCorrelationCPtr;
+
+    class CorrelationSnapshot;
+    typedef boost::shared_ptr<const CorrelationSnapshot> CorrelationSnapshotCPtr;
+
+    class SeparableDistortedPowerCorrelation;
+    typedef boost::shared_ptr<SeparableDistortedPowerCorrelation> SeparableDistortedPowerCorrelationPtr;
+    typedef boost::shared_ptr<const SeparableDistortedPowerCorrelation> SeparableDistortedPowerCorrelationCPtr;
     
     class DistortedPowerCorrelationFft;
     typedef boost::shared_ptr<DistortedPowerCorrelationFft> DistortedPowerCorrelationFftPtr;
@@ -30,7 +30,7 @@ int main(int argc, char **argv) {
     double OmegaMatter,OmegaBaryon,hubbleConstant,cmbTemp,spectralIndex,sigma8,
         zval,kval,kmin,kmax,r1d,rmin,rmax,baoAmplitude,baoSigma,baoScale;
     double bbandP,bbandCoef,bbandKmin,bbandRmin,bbandR0,bbandVar,epsAbs,epsRel;
-    int nk,nr;
+    int nk,nr,tabulateTransfer;
     std::string loadPowerFile,savePowerFile,saveCorrelationFile;
     cli.add_options()
         ("help,h", "Prints this info and exits.")
@@ -81,6 +81,8 @@ int main(int argc, char **argv) {
         ("quad", "Calculates the quadrupole (l=2) correlation function (default is monopole).")
         ("hexa", "Calculates the hexedacapole (l=4) correlation function (default is monopole).")
         ("no-wiggles", "Calculates the power spectrum without baryon acoustic oscillations.")
+        ("tabulate-transfer", po::value<int>(&tabulateTransfer)->default_value(0),
+            "Interpolates transfer functions tabulated with this many samples per decade (0 = exact).")
         ("no-osc", "Calculates the power spectrum with a non-oscillation baryon transfer function.")
         ("periodic-osc", "Calculates the power spectrum with periodic acoustic oscillations.")
         ("bao-amplitude", po::value<double>(&baoAmplitude)->default_value(1),
@@ -170,6 +172,9 @@ int main(int argc, char **argv) {
             boost::shared_ptr<cosmo::BaryonPerturbations> baryonsPtr(
                 new cosmo::BaryonPerturbations(
                 OmegaMatter,OmegaBaryon,hubbleConstant,cmbTemp,baoOption));
+            if(tabulateTransfer > 0) {
+                baryonsPtr->tabulate(1e-4,1e2,tabulateTransfer);
+            }
             if(verbose) {
                 // Print inhomogeneous cosmology info.
                 std::cout << "z(eq) = " << baryonsPtr->getMatterRadiationEqualityRedshift() << std::endl;
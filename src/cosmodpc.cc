@@ -76,9 +76,9 @@ int main(int argc, char **argv) {
     
     // Configure command-line option processing
     po::options_description cli("Cosmology distorted power correlation function");
-    std::string input,delta,output;
-    int ellMax,nr,repeat,nk,nmu,samplesPerDecade;
-    double rmin,rmax,relerr,abserr,abspow,maxRelError,kmin,kmax,margin,vepsMin,vepsMax;
+    std::string input,delta,output,saveState,restoreState,rgridType;
+    int ellMax,nr,repeat,nk,nmu,samplesPerDecade,nmuQuadrature,verifyPeriod;
+    double rmin,rmax,relerr,abserr,abspow,maxRelError,kmin,kmax,margin,vepsMin,vepsMax,maxDrift;
     double bias,biasbeta,biasGamma,biasSourceAbsorber,biasAbsorberResponse,meanFreePath,
         snlPar,snlPerp,k0,sigk;
     cli.add_options()
@@ -98,6 +98,8 @@ int main(int argc, char **argv) {
             "number of points spanning [rmin,rmax] to use")
         ("ell-max", po::value<int>(&ellMax)->default_value(4),
             "maximum multipole to use for transforms")
+        ("r-grid", po::value<std::string>(&rgridType)->default_value("uniform"),
+            "r grid to use after initialization (uniform, adaptive, native)")
         ("asymmetric", "distortion is asymmetric in mu (uses odd ell values)")
         ("bias", po::value<double>(&bias)->default_value(-0.17),
             "linear tracer bias")
@@ -135,10 +137,21 @@ int main(int argc, char **argv) {
             "number of samples per decade to use for transform interpolation in k")
         ("max-rel-error", po::value<double>(&maxRelError)->default_value(1e-3),
             "maximum allowed relative error for power-law extrapolation of input P(k)")
+        ("mu-quadrature", po::value<int>(&nmuQuadrature)->default_value(0),
+            "number of Gauss-Legendre mu_k nodes for power multipoles (or zero for adaptive)")
         ("direct-power-multipoles",
             "use direct calculation of P(k) multipoles instead of interpolation")
         ("optimize", "optimizes transform FFTs")
+        ("save-state", po::value<std::string>(&saveState)->default_value(""),
+            "filename for saving the initialized state (including FFT wisdom)")
+        ("restore-state", po::value<std::string>(&restoreState)->default_value(""),
+            "filename of a saved state to restore instead of initializing")
+        ("batch", "transforms all multipoles together using a shared k grid")
         ("bypass", "bypasses the termination test for transforms")
+        ("verify-period", po::value<int>(&verifyPeriod)->default_value(1),
+            "verifies the termination test every N transforms (1 = always)")
+        ("max-drift", po::value<double>(&maxDrift)->default_value(0.1),
+            "forces verification when results drift by more than this (with verify-period > 1)")
         ("repeat", po::value<int>(&repeat)->default_value(1),
             "number of times to repeat identical transform")
         ("kmin", po::value<double>(&kmin)->default_value(0.005),
@@ -165,14 +178,9 @@ int main(int argc, char **argv) {
         return 1;
     }
     bool verbose(vm.count("verbose")), symmetric(0==vm.count("asymmetric")),
-        optimize(vm.count("optimize")), bypass(vm.count("bypass")),
+        optimize(vm.count("optimize")), bypass(vm.count("bypass")), batch(vm.count("batch")),
         directPowerMultipoles(vm.count("direct-power-multipoles"));
 
-    if(!symmetric) {
-        std::cerr << "Odd multipoles not implemented yet." << std::endl;
-        return 1;
-    }
-
     if(input.length() == 0) {
         std::cerr << "Missing input filename." << std::endl;
         return 1;
@@ -203,9 +211,29 @@ int main(int argc, char **argv) {
         int nkint = std::ceil(std::log10(khi/klo)*samplesPerDecade);
     	cosmo::DistortedPowerCorrelation dpc(PkPtr,distPtr,
             klo,khi,nkint,rmin,rmax,nr,ellMax,
-            symmetric,relerr,abserr,abspow);
-        // initialize
-        dpc.initialize(nmu,margin,vepsMax,vepsMin,optimize);
+            symmetric,relerr,abserr,abspow,nmuQuadrature);
+        if(verifyPeriod > 1) {
+            dpc.setVerificationPolicy(cosmo::AdaptiveMultipoleTransform::PeriodicVerify,
+                verifyPeriod,maxDrift);
+        }
+        // initialize (or restore a previously saved initialization)
+        if(restoreState.length() > 0) {
+            dpc.restore(restoreState,optimize,batch);
+        }
+        else {
+            dpc.initialize(nmu,margin,vepsMax,vepsMin,optimize,batch);
+        }
+        if(rgridType == "adaptive") {
+            dpc.setRGrid(cosmo::DistortedPowerCorrelation::AdaptiveRGrid,margin);
+        }
+        else if(rgridType == "native") {
+            dpc.setRGrid(cosmo::DistortedPowerCorrelation::NativeRGrid);
+        }
+        else if(rgridType != "uniform") {
+            std::cerr << "Invalid r-grid option: " << rgridType << std::endl;
+            return -2;
+        }
+        if(saveState.length() > 0) dpc.save(saveState,true);
         if(verbose) dpc.printToStream(std::cout);
         // transform (with repeats, if requested)
         bool ok;
@@ -0,0 +1,365 @@
+// Created 18-Oct-2026
+// A benchmark program for the DistortedPowerCorrelation and DistortedPowerCorrelationFft
+// classes that mimics a fit loop: the distortion parameters are changed at each step, the
+// model is re-transformed and then evaluated at the centers of a grid of (r,mu) data bins.
+// Reports the wall time, heap allocations and peak memory used by each stage. When the
+// library is configured with --enable-instrumentation, the time spent in each stage of the
+// transforms is also reported (see cosmo/Instrumentation.h).
+
+#include "cosmo/cosmo.h"
+#include "likely/likely.h"
+#include "likely/function_impl.h"
+
+#include "boost/program_options.hpp"
+#include "boost/format.hpp"
+#include "boost/bind.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <new>
+#include <cmath>
+#include <cstdlib>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+namespace po = boost::program_options;
+namespace lk = likely;
+
+// Count heap allocations made via operator new. The counters are updated atomically
+// since the transforms can allocate from several OpenMP threads.
+namespace {
+    unsigned long allocCount(0), allocBytes(0);
+}
+
+#if __cplusplus >= 201103L
+#define BENCH_THROW_BAD_ALLOC
+#define BENCH_NO_THROW noexcept
+#else
+#define BENCH_THROW_BAD_ALLOC throw(std::bad_alloc)
+#define BENCH_NO_THROW throw()
+#endif
+
+void *operator new(std::size_t size) BENCH_THROW_BAD_ALLOC {
+    __sync_fetch_and_add(&allocCount,1UL);
+    __sync_fetch_and_add(&allocBytes,(unsigned long)size);
+    void *ptr = std::malloc(size ? size : 1);
+    if(0 == ptr) throw std::bad_alloc();
+    return ptr;
+}
+void *operator new[](std::size_t size) BENCH_THROW_BAD_ALLOC { return operator new(size); }
+void operator delete(void *ptr) BENCH_NO_THROW { std::free(ptr); }
+void operator delete[](void *ptr) BENCH_NO_THROW { std::free(ptr); }
+
+// Returns the elapsed wall-clock time in seconds since some arbitrary origin.
+double wallTime() {
+    struct timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+// Returns the peak resident set size of this process in megabytes.
+double peakMemory() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF,&usage);
+#ifdef __APPLE__
+    // ru_maxrss is in bytes on OS X
+    return usage.ru_maxrss/1048576.;
+#else
+    // ru_maxrss is in kilobytes on linux
+    return usage.ru_maxrss/1024.;
+#endif
+}
+
+// Accumulates the resources used by each named stage of a benchmark.
+struct StageStats {
+    StageStats() : calls(0), time(0), allocs(0), bytes(0) { }
+    int calls;
+    double time;
+    unsigned long allocs, bytes;
+};
+typedef std::map<std::string,StageStats> StageStatsMap;
+
+// Measures the resources used during the lifetime of this object and adds them to
+// the named stage.
+class StageTimer {
+public:
+    StageTimer(StageStatsMap &stats, std::string const &name)
+    : _stats(stats[name]), _allocs(allocCount), _bytes(allocBytes), _start(wallTime()) { }
+    ~StageTimer() {
+        _stats.calls++;
+        _stats.time += wallTime() - _start;
+        _stats.allocs += allocCount - _allocs;
+        _stats.bytes += allocBytes - _bytes;
+    }
+private:
+    StageStats &_stats;
+    unsigned long _allocs, _bytes;
+    double _start;
+};
+
+void printStats(std::string const &title, StageStatsMap const &stats, double memBefore) {
+    std::cout << std::endl << "== " << title << " (peak RSS "
+        << boost::format("%.1f Mb, +%.1f Mb") % peakMemory() % (peakMemory() - memBefore)
+        << ")" << std::endl;
+    std::cout << boost::format("%-12s %6s %10s %12s %12s %12s\n")
+        % "stage" % "calls" % "total(s)" % "ms/call" % "allocs/call" % "kb/call";
+    for(StageStatsMap::const_iterator iter = stats.begin(); iter != stats.end(); ++iter) {
+        StageStats const &s(iter->second);
+        double n = s.calls > 0 ? s.calls : 1;
+        std::cout << boost::format("%-12s %6d %10.3f %12.3f %12.1f %12.1f\n")
+            % iter->first % s.calls % s.time % (1e3*s.time/n) % (s.allocs/n) % (s.bytes/n/1024.);
+    }
+}
+
+class LyaDistortion {
+// The simple autocorrelation distortion model used by cosmodpc, with linear redshift space
+// effects (bias,beta), non-linear large-scale broadening (snlPar,snlPerp) and a continuum
+// fitting broadband distortion model (k0,sigk). The bias parameters can be changed between
+// transforms to simulate a fit.
+public:
+    LyaDistortion(double bias, double biasbeta, double snlPar, double snlPerp,
+        double k0, double sigk) :
+        _bias(bias), _biasbeta(biasbeta), _snlPar2(snlPar*snlPar), _snlPerp2(snlPerp*snlPerp),
+        _k0(k0), _sigk(sigk)
+    {
+        _distScale = sigk > 0 ? 1/(1 + std::tanh(k0/sigk)) : 0;
+    }
+    void setBias(double bias, double biasbeta) {
+        _bias = bias;
+        _biasbeta = biasbeta;
+    }
+    double operator()(double k, double mu) const {
+        double beta(_biasbeta/_bias);
+        double mu2(mu*mu);
+        double linear = _bias*(1 + beta*mu2);
+        double snl2 = _snlPar2*mu2 + (1 - mu2)*_snlPerp2;
+        double nonlinear = std::exp(-0.5*k*k*snl2);
+        double kpar = std::fabs(k*mu);
+        double distortion = _sigk > 0 ? 1 - _distScale*(1 - std::tanh((kpar-_k0)/_sigk)) : 1;
+        return distortion*nonlinear*linear*linear;
+    }
+    // Evaluates the same distortion with the signature used by DistortedPowerCorrelationFft.
+    double evaluateWithPower(double k, double mu, double pk) const {
+        return (*this)(k,mu);
+    }
+private:
+    double _bias,_biasbeta,_snlPar2,_snlPerp2,_k0,_sigk,_distScale;
+};
+
+int main(int argc, char **argv) {
+
+    // Configure command-line option processing
+    po::options_description cli("Distorted power correlation fit-loop benchmark");
+    std::string input;
+    int ellMax,nr,samplesPerDecade,nmuQuadrature,nx,ny,nz,steps,nrBins,nmuBins,verifyPeriod;
+    double rmin,rmax,relerr,abserr,abspow,maxRelError,spacing,variation,maxDrift;
+    double bias,biasbeta,snlPar,snlPerp,k0,sigk;
+    cli.add_options()
+        ("help,h", "prints this info and exits.")
+        ("verbose", "prints additional information.")
+        ("input,i", po::value<std::string>(&input)->default_value(""),
+            "filename to read k,P(k) values from")
+        ("steps", po::value<int>(&steps)->default_value(100),
+            "number of fit-loop steps to simulate")
+        ("variation", po::value<double>(&variation)->default_value(0.05),
+            "fractional variation of the bias parameters between steps")
+        ("rmin", po::value<double>(&rmin)->default_value(10.),
+            "minimum value of comoving separation to use")
+        ("rmax", po::value<double>(&rmax)->default_value(200.),
+            "maximum value of comoving separation to use")
+        ("nr", po::value<int>(&nr)->default_value(191),
+            "number of points spanning [rmin,rmax] to use for interpolation")
+        ("ell-max", po::value<int>(&ellMax)->default_value(4),
+            "maximum multipole to use for transforms")
+        ("samples-per-decade", po::value<int>(&samplesPerDecade)->default_value(40),
+            "number of samples per decade to use for transform interpolation in k")
+        ("mu-quadrature", po::value<int>(&nmuQuadrature)->default_value(0),
+            "number of Gauss-Legendre mu_k nodes for power multipoles (or zero for adaptive)")
+        ("relerr", po::value<double>(&relerr)->default_value(1e-3),
+            "relative error termination goal")
+        ("abserr", po::value<double>(&abserr)->default_value(1e-5),
+            "absolute error termination goal")
+        ("abspow", po::value<double>(&abspow)->default_value(0.),
+            "absolute error weighting power")
+        ("optimize", "optimizes transform FFTs")
+        ("batch", "transforms all multipoles together using a shared k grid")
+        ("bypass", "bypasses the termination test for transforms")
+        ("verify-period", po::value<int>(&verifyPeriod)->default_value(1),
+            "verifies the termination test every N transforms (1 = always)")
+        ("max-drift", po::value<double>(&maxDrift)->default_value(0.1),
+            "forces verification when results drift by more than this (with verify-period > 1)")
+        ("nr-bins", po::value<int>(&nrBins)->default_value(50),
+            "number of data bins in r covering [rmin,rmax]")
+        ("nmu-bins", po::value<int>(&nmuBins)->default_value(20),
+            "number of data bins in mu covering [0,1]")
+        ("spacing", po::value<double>(&spacing)->default_value(4),
+            "FFT grid spacing in Mpc/h")
+        ("nx", po::value<int>(&nx)->default_value(256),
+            "FFT grid size along x-axis")
+        ("ny", po::value<int>(&ny)->default_value(0),
+            "FFT grid size along line-of-sight y-axis (or zero for ny=nx)")
+        ("nz", po::value<int>(&nz)->default_value(0),
+            "FFT grid size along z-axis (or zero for nz=ny)")
+        ("no-dpc", "skips the DistortedPowerCorrelation benchmark")
+        ("no-fft", "skips the DistortedPowerCorrelationFft benchmark")
+        ("bias", po::value<double>(&bias)->default_value(-0.17),
+            "linear tracer bias")
+        ("biasbeta", po::value<double>(&biasbeta)->default_value(-0.17),
+            "product of bias and linear redshift-space distortion parameter beta")
+        ("snl-par", po::value<double>(&snlPar)->default_value(0.),
+            "parallel component of non-linear broadening in Mpc/h")
+        ("snl-perp", po::value<double>(&snlPerp)->default_value(0.),
+            "perpendicular component of non-linear broadening in Mpc/h")
+        ("k0", po::value<double>(&k0)->default_value(0.02),
+            "cutoff scale for broadband distortion in h/Mpc (ignored when sigk = 0)")
+        ("sigk", po::value<double>(&sigk)->default_value(0.),
+            "smoothing scale for broadband distortion in h/Mpc (or zero for no distortion)")
+        ("max-rel-error", po::value<double>(&maxRelError)->default_value(1e-3),
+            "maximum allowed relative error for power-law extrapolation of input P(k)")
+        ;
+    // do the command line parsing now
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, cli), vm);
+        po::notify(vm);
+    }
+    catch(std::exception const &e) {
+        std::cerr << "Unable to parse command line options: " << e.what() << std::endl;
+        return -1;
+    }
+    if(vm.count("help")) {
+        std::cout << cli << std::endl;
+        return 1;
+    }
+    bool verbose(vm.count("verbose")), optimize(vm.count("optimize")), batch(vm.count("batch")),
+        bypass(vm.count("bypass")), noDpc(vm.count("no-dpc")), noFft(vm.count("no-fft"));
+
+    if(input.length() == 0) {
+        std::cerr << "Missing input filename." << std::endl;
+        return 1;
+    }
+    if(steps < 1 || nrBins < 1 || nmuBins < 1) {
+        std::cerr << "Expected steps, nr-bins and nmu-bins > 0." << std::endl;
+        return 1;
+    }
+    if(0 == ny) ny = nx;
+    if(0 == nz) nz = ny;
+
+    try {
+        cosmo::TabulatedPowerCPtr power =
+            cosmo::createTabulatedPower(input,true,true,maxRelError,verbose);
+        lk::GenericFunctionPtr PkPtr =
+            lk::createFunctionPtr<const cosmo::TabulatedPower>(power);
+
+        // Both models share the same distortion object
+        boost::shared_ptr<LyaDistortion> rsd(new LyaDistortion(
+            bias,biasbeta,snlPar,snlPerp,k0,sigk));
+        cosmo::RMuFunctionCPtr distPtr(new cosmo::RMuFunction(boost::bind(
+            &LyaDistortion::operator(),rsd,_1,_2)));
+        cosmo::KMuPkFunctionCPtr distFftPtr(new cosmo::KMuPkFunction(boost::bind(
+            &LyaDistortion::evaluateWithPower,rsd,_1,_2,_3)));
+
+        // Tabulate the (r,mu) bin centers where each model is evaluated
+        std::vector<double> rbins, mubins;
+        double dr = (rmax - rmin)/nrBins, dmu = 1./nmuBins;
+        for(int i = 0; i < nrBins; ++i) {
+            for(int j = 0; j < nmuBins; ++j) {
+                rbins.push_back(rmin + (i+0.5)*dr);
+                mubins.push_back((j+0.5)*dmu);
+            }
+        }
+        int nbins(rbins.size());
+        std::cout << "Simulating " << steps << " fit steps with " << nbins << " data bins." << std::endl;
+
+        std::vector<double> xiDpc, xiFft(nbins);
+        if(!noDpc) {
+            double memBefore(peakMemory());
+            StageStatsMap stats;
+            cosmo::instrument::reset();
+            rsd->setBias(bias,biasbeta);
+            double klo = power->getKMin(), khi = power->getKMax();
+            int nkint = std::ceil(std::log10(khi/klo)*samplesPerDecade);
+            boost::scoped_ptr<cosmo::DistortedPowerCorrelation> dpc;
+            boost::scoped_ptr<cosmo::CorrelationProjector> projector;
+            {
+                StageTimer timer(stats,"setup");
+                dpc.reset(new cosmo::DistortedPowerCorrelation(PkPtr,distPtr,
+                    klo,khi,nkint,rmin,rmax,nr,ellMax,true,relerr,abserr,abspow,nmuQuadrature));
+                if(verifyPeriod > 1) {
+                    dpc->setVerificationPolicy(cosmo::AdaptiveMultipoleTransform::PeriodicVerify,
+                        verifyPeriod,maxDrift);
+                }
+                dpc->initialize(20,2,0.01,1e-6,optimize,batch);
+                projector.reset(new cosmo::CorrelationProjector(*dpc,rbins,mubins));
+            }
+            if(verbose) dpc->printToStream(std::cout);
+            int nfail(0);
+            for(int step = 0; step < steps; ++step) {
+                double scale = 1 + variation*std::sin(step + 1.);
+                rsd->setBias(bias*scale,biasbeta/scale);
+                {
+                    StageTimer timer(stats,"transform");
+                    if(!dpc->transform(true,bypass)) nfail++;
+                }
+                {
+                    StageTimer timer(stats,"evaluate");
+                    dpc->getCorrelation(*projector,xiDpc);
+                }
+            }
+            printStats("DistortedPowerCorrelation",stats,memBefore);
+            if(cosmo::instrument::isEnabled()) cosmo::instrument::printToStream(std::cout);
+            if(nfail > 0) {
+                std::cout << nfail << " of " << steps << " transforms failed the termination test."
+                    << std::endl;
+            }
+        }
+        if(!noFft) {
+            double memBefore(peakMemory());
+            StageStatsMap stats;
+            cosmo::instrument::reset();
+            rsd->setBias(bias,biasbeta);
+            boost::scoped_ptr<cosmo::DistortedPowerCorrelationFft> fft;
+            {
+                StageTimer timer(stats,"setup");
+                fft.reset(new cosmo::DistortedPowerCorrelationFft(PkPtr,distFftPtr,spacing,nx,ny,nz));
+            }
+            if(verbose) {
+                std::cout << "FFT memory size = "
+                    << boost::format("%.1f Mb") % (fft->getMemorySize()/1048576.) << std::endl;
+            }
+            for(int step = 0; step < steps; ++step) {
+                double scale = 1 + variation*std::sin(step + 1.);
+                rsd->setBias(bias*scale,biasbeta/scale);
+                {
+                    StageTimer timer(stats,"transform");
+                    fft->transform();
+                }
+                {
+                    StageTimer timer(stats,"evaluate");
+                    for(int i = 0; i < nbins; ++i) xiFft[i] = fft->getCorrelation(rbins[i],mubins[i]);
+                }
+            }
+            printStats("DistortedPowerCorrelationFft",stats,memBefore);
+            if(cosmo::instrument::isEnabled()) cosmo::instrument::printToStream(std::cout);
+        }
+        // Compare the final predictions of both models
+        if(!noDpc && !noFft) {
+            double maxDiff(0), maxXi(0);
+            for(int i = 0; i < nbins; ++i) {
+                double r2 = rbins[i]*rbins[i];
+                maxDiff = std::max(maxDiff,r2*std::fabs(xiDpc[i] - xiFft[i]));
+                maxXi = std::max(maxXi,r2*std::fabs(xiDpc[i]));
+            }
+            std::cout << std::endl << "Max |r^2 dxi| = " << maxDiff << " (max |r^2 xi| = "
+                << maxXi << ")" << std::endl;
+        }
+    }
+    catch(std::runtime_error const &e) {
+        std::cerr << "ERROR: exiting with an exception:\n  " << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
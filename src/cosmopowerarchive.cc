@@ -0,0 +1,133 @@
+// Created 18-Oct-2026
+// A driver program for the TabulatedPowerArchive class. Packs k,P(k) text files into a
+// single binary archive (using each filename as the spectrum name) or lists the contents
+// of an existing archive, comparing the time to load its spectra with the time to parse
+// the original text files when they are available.
+
+#include "cosmo/cosmo.h"
+
+#include "boost/program_options.hpp"
+#include "boost/format.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+namespace po = boost::program_options;
+
+// Returns the elapsed wall-clock time in seconds since some arbitrary origin.
+double wallTime() {
+    struct timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+int main(int argc, char **argv) {
+
+    // Configure command-line option processing
+    po::options_description cli("Tabulated power spectrum archive tool");
+    std::string archive;
+    std::vector<std::string> inputs;
+    double maxRelError;
+    cli.add_options()
+        ("help,h", "prints this info and exits.")
+        ("verbose", "prints additional information.")
+        ("archive,a", po::value<std::string>(&archive)->default_value(""),
+            "Name of the archive file to create or list.")
+        ("input,i", po::value<std::vector<std::string> >(&inputs),
+            "k,P(k) text files to pack (can also be listed after other options).")
+        ("list", "lists the contents of an existing archive instead of creating one.")
+        ("no-extrapolate", "disables power-law extrapolation of the packed spectra.")
+        ("max-rel-error", po::value<double>(&maxRelError)->default_value(1e-3),
+            "Maximum allowed relative error for power-law extrapolation of input P(k).")
+        ;
+    po::positional_options_description positional;
+    positional.add("input",-1);
+
+    // do the command line parsing now
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc,argv).options(cli).positional(positional).run(), vm);
+        po::notify(vm);
+    }
+    catch(std::exception const &e) {
+        std::cerr << "Unable to parse command line options: " << e.what() << std::endl;
+        return -1;
+    }
+    if(vm.count("help")) {
+        std::cout << cli << std::endl;
+        return 1;
+    }
+    bool verbose(vm.count("verbose")), list(vm.count("list")),
+        extrapolate(0 == vm.count("no-extrapolate"));
+
+    if(archive.length() == 0) {
+        std::cerr << "Missing archive filename." << std::endl;
+        return 1;
+    }
+    if(!list && inputs.empty()) {
+        std::cerr << "Missing input filenames." << std::endl;
+        return 1;
+    }
+
+    try {
+        if(list) {
+            double start = wallTime();
+            cosmo::TabulatedPowerArchive contents(archive);
+            int count(contents.getNumSpectra());
+            std::vector<cosmo::TabulatedPowerCPtr> powers;
+            powers.reserve(count);
+            for(int index = 0; index < count; ++index) {
+                powers.push_back(contents.getPower(index));
+            }
+            double elapsed = wallTime() - start;
+            boost::format fmt("%-40s %12g %12g %s\n");
+            for(int index = 0; index < count; ++index) {
+                cosmo::TabulatedPower const &power = *powers[index];
+                std::cout << fmt % contents.getName(index) % power.getKMin() % power.getKMax()
+                    % (power.isLogUniform() ? "log-uniform" : "");
+            }
+            std::cout << "Loaded " << count << " spectra in " << 1e3*elapsed << " ms." << std::endl;
+            // Compare with the time to parse the original text files (whose names are the
+            // spectrum names) when they are available.
+            std::vector<std::string> found;
+            for(int index = 0; index < count; ++index) {
+                std::ifstream test(contents.getName(index).c_str());
+                if(test.good()) found.push_back(contents.getName(index));
+            }
+            if(!found.empty()) {
+                start = wallTime();
+                std::vector<cosmo::TabulatedPowerCPtr> parsed;
+                parsed.reserve(found.size());
+                for(int index = 0; index < found.size(); ++index) {
+                    parsed.push_back(cosmo::createTabulatedPower(found[index],
+                        extrapolate,extrapolate,maxRelError,verbose));
+                }
+                elapsed = wallTime() - start;
+                std::cout << "Parsed " << found.size() << " of the original text files in "
+                    << 1e3*elapsed << " ms." << std::endl;
+            }
+        }
+        else {
+            double start = wallTime();
+            std::vector<cosmo::TabulatedPowerCPtr> powers;
+            powers.reserve(inputs.size());
+            for(int index = 0; index < inputs.size(); ++index) {
+                powers.push_back(cosmo::createTabulatedPower(inputs[index],
+                    extrapolate,extrapolate,maxRelError,verbose));
+            }
+            double elapsed = wallTime() - start;
+            cosmo::TabulatedPowerArchive::write(archive,inputs,powers);
+            std::cout << "Packed " << inputs.size() << " spectra (parsed in " << 1e3*elapsed
+                << " ms) into " << archive << std::endl;
+        }
+    }
+    catch(std::runtime_error const &e) {
+        std::cerr << "ERROR: exiting with an exception:\n  " << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
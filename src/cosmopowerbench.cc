@@ -0,0 +1,174 @@
+// Created 18-Oct-2026
+// A benchmark program for TabulatedPower lookups. Compares the time per evaluation of
+// a general cspline interpolator in log(k) (which uses a binary search for each k) with
+// TabulatedPower::operator() (which finds the spline segment in constant time when the
+// input k values are logarithmically spaced) and TabulatedPower::evaluateLogGrid,
+// and reports the largest relative difference between the methods. Use --round-k to
+// check the case of log-spaced k values that were rounded when they were written out.
+
+#include "cosmo/cosmo.h"
+#include "likely/likely.h"
+
+#include "boost/program_options.hpp"
+#include "boost/format.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <sys/time.h>
+
+namespace po = boost::program_options;
+namespace lk = likely;
+
+// Returns the elapsed wall-clock time in seconds since some arbitrary origin.
+double wallTime() {
+    struct timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+int main(int argc, char **argv) {
+
+    // Configure command-line option processing
+    po::options_description cli("Tabulated power spectrum lookup benchmark");
+    std::string input;
+    int npoints,repeat,roundK;
+    unsigned int seed;
+    double maxRelError;
+    cli.add_options()
+        ("help,h", "prints this info and exits.")
+        ("verbose", "prints additional information.")
+        ("input,i", po::value<std::string>(&input)->default_value(""),
+            "Filename to read k,P(k) values from.")
+        ("npoints", po::value<int>(&npoints)->default_value(10000),
+            "Number of k values to evaluate in each repetition.")
+        ("repeat", po::value<int>(&repeat)->default_value(100),
+            "Number of repetitions to time.")
+        ("seed", po::value<unsigned int>(&seed)->default_value(1234),
+            "Random seed for generating k values.")
+        ("max-rel-error", po::value<double>(&maxRelError)->default_value(1e-3),
+            "Maximum allowed relative error for power-law extrapolation of input P(k).")
+        ("round-k", po::value<int>(&roundK)->default_value(0),
+            "Rounds input k values to this many significant digits (0 = no rounding).")
+        ;
+
+    // do the command line parsing now
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, cli), vm);
+        po::notify(vm);
+    }
+    catch(std::exception const &e) {
+        std::cerr << "Unable to parse command line options: " << e.what() << std::endl;
+        return -1;
+    }
+    if(vm.count("help")) {
+        std::cout << cli << std::endl;
+        return 1;
+    }
+    bool verbose(vm.count("verbose"));
+
+    if(input.length() == 0) {
+        std::cerr << "Missing input filename." << std::endl;
+        return 1;
+    }
+    if(npoints < 2 || repeat < 1 || roundK < 0) {
+        std::cerr << "Expected npoints > 1, repeat > 0 and round-k >= 0." << std::endl;
+        return 1;
+    }
+
+    try {
+        std::vector<std::vector<double> > columns(2);
+        std::ifstream in(input.c_str());
+        lk::readVectors(in,columns);
+        // Round the input k values, if requested, the way a %.<n-1>e output format does
+        if(roundK > 0) {
+            char buffer[64];
+            for(int i = 0; i < columns[0].size(); ++i) {
+                std::sprintf(buffer,"%.*e",roundK-1,columns[0][i]);
+                columns[0][i] = std::atof(buffer);
+            }
+        }
+        cosmo::TabulatedPowerCPtr power(new cosmo::TabulatedPower(columns[0],columns[1],
+            false,false,maxRelError,verbose));
+        std::cout << "Input k values are " << (power->isLogUniform() ? "" : "not ")
+            << "logarithmically spaced." << std::endl;
+
+        // Build the general interpolator in log(k) that TabulatedPower used previously
+        std::vector<double> logk(columns[0].size());
+        for(int i = 0; i < logk.size(); ++i) logk[i] = std::log(columns[0][i]);
+        lk::Interpolator cspline(logk,columns[1],"cspline");
+
+        // Generate random and log-spaced k values covering the tabulated range (shrunk
+        // slightly so that roundoff never takes us outside it)
+        double kmin(power->getKMin()), kmax(power->getKMax());
+        double logkMin(std::log(kmin)), logkMax(std::log(kmax));
+        double dlogk = (1 - 1e-12)*(logkMax - logkMin)/(npoints - 1);
+        std::vector<double> krandom(npoints), kgrid(npoints);
+        std::srand(seed);
+        for(int i = 0; i < npoints; ++i) {
+            double u = std::rand()/(RAND_MAX + 1.);
+            krandom[i] = std::min(kmax,std::max(kmin,std::exp(logkMin + u*(logkMax - logkMin))));
+            kgrid[i] = std::min(kmax,std::max(kmin,std::exp(logkMin + i*dlogk)));
+        }
+
+        std::vector<double> pcspline(npoints), ptabulated(npoints), pgrid(npoints);
+        boost::format fmt("%-26s %10.2f ns/eval  max rel diff %.2g\n");
+        for(int pass = 0; pass < 2; ++pass) {
+            std::vector<double> const &kvalues = pass ? kgrid : krandom;
+            std::cout << std::endl << (pass ? "Log-spaced" : "Random") << " k values:" << std::endl;
+            double sum(0);
+            // Time the general interpolator
+            double start = wallTime();
+            for(int rep = 0; rep < repeat; ++rep) {
+                for(int i = 0; i < npoints; ++i) {
+                    pcspline[i] = cspline(std::log(kvalues[i]));
+                }
+                sum += pcspline[rep % npoints];
+            }
+            double tcspline = wallTime() - start;
+            // Time TabulatedPower::operator()
+            start = wallTime();
+            for(int rep = 0; rep < repeat; ++rep) {
+                for(int i = 0; i < npoints; ++i) {
+                    ptabulated[i] = (*power)(kvalues[i]);
+                }
+                sum += ptabulated[rep % npoints];
+            }
+            double ttabulated = wallTime() - start;
+            double maxDiff(0);
+            for(int i = 0; i < npoints; ++i) {
+                maxDiff = std::max(maxDiff,std::fabs(ptabulated[i]/pcspline[i] - 1));
+            }
+            double scale = 1e9/repeat/npoints;
+            std::cout << fmt % "cspline interpolator" % (scale*tcspline) % 0.;
+            std::cout << fmt % "TabulatedPower" % (scale*ttabulated) % maxDiff;
+            // Time TabulatedPower::evaluateLogGrid
+            if(pass) {
+                start = wallTime();
+                for(int rep = 0; rep < repeat; ++rep) {
+                    power->evaluateLogGrid(logkMin,dlogk,pgrid);
+                    sum += pgrid[rep % npoints];
+                }
+                double tgrid = wallTime() - start;
+                maxDiff = 0;
+                for(int i = 0; i < npoints; ++i) {
+                    maxDiff = std::max(maxDiff,std::fabs(pgrid[i]/pcspline[i] - 1));
+                }
+                std::cout << fmt % "TabulatedPower log grid" % (scale*tgrid) % maxDiff;
+            }
+            if(verbose) std::cout << "checksum = " << sum << std::endl;
+        }
+    }
+    catch(std::runtime_error const &e) {
+        std::cerr << "ERROR: exiting with an exception:\n  " << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -12,17 +12,51 @@
 
 #include <iostream>
 #include <fstream>
+#include <cmath>
+#include <sys/time.h>
 
 namespace po = boost::program_options;
 namespace lk = likely;
 
+// Returns the elapsed wall-clock time in seconds since some arbitrary origin.
+double wallTime() {
+    struct timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+// Benchmarks one transform engine against reference results tabulated on a fine grid.
+void compareEngine(std::string const &name, cosmo::AbsMultipoleTransform const &engine,
+lk::GenericFunctionPtr func, lk::Interpolator const &reference, double vmin, double vmax,
+int repeat) {
+    std::vector<double> const& ugrid = engine.getUGrid(), vgrid = engine.getVGrid();
+    std::vector<double> funcData(ugrid.size()), results;
+    double t0 = wallTime();
+    for(int i = 0; i < funcData.size(); ++i) {
+        funcData[i] = (*func)(ugrid[i]);
+    }
+    double t1 = wallTime();
+    for(int i = 0; i < repeat; ++i) engine.transform(funcData,results);
+    double t2 = wallTime();
+    double maxErr(0), maxAbs(0);
+    for(int i = 0; i < results.size(); ++i) {
+        if(vgrid[i] < vmin || vgrid[i] > vmax) continue;
+        double expected = reference(vgrid[i]);
+        double err = std::fabs(results[i] - expected);
+        if(err > maxErr) maxErr = err;
+        if(std::fabs(expected) > maxAbs) maxAbs = std::fabs(expected);
+    }
+    std::cout << name << ' ' << ugrid.size() << ' ' << 1e6*(t1-t0) << ' '
+        << 1e6*(t2-t1)/repeat << ' ' << maxErr/maxAbs << std::endl;
+}
+
 int main(int argc, char **argv) {
     
     // Configure command-line option processing
     po::options_description cli("Cosmology multipole transforms");
     std::string input,output;
-    int ell,minSamplesPerCycle,minSamplesPerDecade;
-    double min,max,veps,maxRelError;
+    int ell,minSamplesPerCycle,minSamplesPerDecade,nbenchmark,repeat;
+    double min,max,veps,maxRelError,samplesPerDecade,bias,umin,umax;
     cli.add_options()
         ("help,h", "prints this info and exits.")
         ("verbose", "prints additional information.")
@@ -40,10 +74,28 @@ int main(int argc, char **argv) {
         ("veps", po::value<double>(&veps)->default_value(1e-3),
             "desired transform accuracy")
         ("measure", "does initial measurements to optimize FFT plan")
+        ("exact-kernel", "tabulates transform kernel using boost::math instead of fast recurrences")
+        ("validate-kernel", "compares transforms using fast and exact kernel tabulations")
+        ("float", "uses single-precision FFTs for the transform convolution")
+        ("compare-precision", "compares transforms using single- and double-precision FFTs")
+        ("benchmark", po::value<int>(&nbenchmark)->default_value(0),
+            "benchmarks kernel construction time for this many successive halvings of veps")
         ("min-samples-per-cycle", po::value<int>(&minSamplesPerCycle)->default_value(2),
             "minimum number of samples per cycle to use for transform convolution")
         ("min-samples-per-decade", po::value<int>(&minSamplesPerDecade)->default_value(40),
             "minimum number of samples per decade to use for transform convolution")
+        ("fftlog", "uses the FFTLog engine instead of MultipoleTransform")
+        ("samples-per-decade", po::value<double>(&samplesPerDecade)->default_value(50),
+            "number of samples per decade to use with the FFTLog engine")
+        ("bias", po::value<double>(&bias)->default_value(1.5),
+            "power-law bias exponent to use with the FFTLog engine")
+        ("umin", po::value<double>(&umin)->default_value(1e-5),
+            "minimum input coordinate value to tabulate for the FFTLog engine")
+        ("umax", po::value<double>(&umax)->default_value(1e3),
+            "maximum input coordinate value to tabulate for the FFTLog engine")
+        ("compare-engines", "compares points, transform time and accuracy of both engines")
+        ("repeat", po::value<int>(&repeat)->default_value(100),
+            "number of transforms to average when timing engines")
         ("max-rel-error", po::value<double>(&maxRelError)->default_value(1e-3),
             "maximum allowed relative error for power-law extrapolation of input P(k)")
         ;
@@ -62,7 +114,10 @@ int main(int argc, char **argv) {
         return 1;
     }
     bool verbose(vm.count("verbose")),hankel(vm.count("hankel")),
-        measure(vm.count("measure"));
+        measure(vm.count("measure")),exactKernel(vm.count("exact-kernel")),
+        validateKernel(vm.count("validate-kernel")),fftlog(vm.count("fftlog")),
+        singlePrecision(vm.count("float")),comparePrecision(vm.count("compare-precision")),
+        compareEngines(vm.count("compare-engines"));
 
     if(input.length() == 0) {
         std::cerr << "Missing input filename." << std::endl;
@@ -81,16 +136,80 @@ int main(int argc, char **argv) {
         cosmo::MultipoleTransform::MeasurePlan :
         cosmo::MultipoleTransform::EstimatePlan);
 
+    cosmo::MultipoleTransform::Kernel kernel(exactKernel ?
+        cosmo::MultipoleTransform::ExactKernel :
+        cosmo::MultipoleTransform::FastKernel);
+
+    cosmo::MultipoleTransform::Precision precision(singlePrecision ?
+        cosmo::MultipoleTransform::SinglePrecision :
+        cosmo::MultipoleTransform::DoublePrecision);
+
     try {
-    	cosmo::MultipoleTransform mt(ttype,ell,min,max,veps,strategy,
-            minSamplesPerCycle,minSamplesPerDecade);
-        std::vector<double> const& ugrid = mt.getUGrid(), vgrid = mt.getVGrid();
+        if(nbenchmark > 0) {
+            // Compare construction times for fast and exact kernel tabulations.
+            std::cout << "    veps  npoints    fast(s)   exact(s)" << std::endl;
+            double bveps(veps);
+            for(int i = 0; i < nbenchmark; ++i) {
+                double t0 = wallTime();
+                cosmo::MultipoleTransform fast(ttype,ell,min,max,bveps,strategy,
+                    minSamplesPerCycle,minSamplesPerDecade,3,cosmo::MultipoleTransform::FastKernel);
+                double t1 = wallTime();
+                cosmo::MultipoleTransform exact(ttype,ell,min,max,bveps,strategy,
+                    minSamplesPerCycle,minSamplesPerDecade,3,cosmo::MultipoleTransform::ExactKernel);
+                double t2 = wallTime();
+                std::cout << bveps << ' ' << fast.getNumPoints() << ' ' << (t1-t0) << ' '
+                    << (t2-t1) << std::endl;
+                bveps /= 2;
+            }
+        }
+        if(compareEngines) {
+            // Calculate reference results independently of FFTLog (and of its periodic
+            // wrap-around and bias systematics) using a MultipoleTransform with the exact
+            // kernel, a 32x smaller veps and 4x finer minimum sampling.
+            cosmo::MultipoleTransform ref(ttype,ell,min,max,veps/32,strategy,
+                minSamplesPerCycle,4*minSamplesPerDecade,3,cosmo::MultipoleTransform::ExactKernel);
+            std::vector<double> refData(ref.getUGrid().size()), refResults;
+            for(int i = 0; i < refData.size(); ++i) {
+                refData[i] = (*PkPtr)(ref.getUGrid()[i]);
+            }
+            ref.transform(refData,refResults);
+            lk::Interpolator reference(ref.getVGrid(),refResults,"cspline");
+            // Estimate the accuracy of the reference itself by comparing with 2x its veps.
+            cosmo::MultipoleTransform ref2(ttype,ell,min,max,veps/16,strategy,
+                minSamplesPerCycle,4*minSamplesPerDecade,3,cosmo::MultipoleTransform::ExactKernel);
+            std::cout << "engine npoints eval(us) transform(us) maxRelError" << std::endl;
+            compareEngine("Reference(2*veps)",ref2,PkPtr,reference,min,max,1);
+            cosmo::MultipoleTransform mtEngine(ttype,ell,min,max,veps,strategy,
+                minSamplesPerCycle,minSamplesPerDecade,3,kernel);
+            compareEngine("MultipoleTransform",mtEngine,PkPtr,reference,min,max,repeat);
+            cosmo::FftLogTransform fftlogEngine(ttype,ell,min,max,umin,umax,
+                samplesPerDecade,bias,strategy);
+            compareEngine("FftLogTransform",fftlogEngine,PkPtr,reference,min,max,repeat);
+        }
+        boost::scoped_ptr<cosmo::AbsMultipoleTransform> engine;
+        if(fftlog) {
+            cosmo::FftLogTransform *flt = new cosmo::FftLogTransform(ttype,ell,min,max,
+                umin,umax,samplesPerDecade,bias,strategy);
+            engine.reset(flt);
+            if(verbose) {
+                std::cout << "FFTLog uses " << flt->getNumPoints() << " points with bias "
+                    << flt->getBias() << " and u*v = " << flt->getUVProduct() << std::endl;
+            }
+        }
+        else {
+            cosmo::MultipoleTransform *mt = new cosmo::MultipoleTransform(ttype,ell,min,max,
+                veps,strategy,minSamplesPerCycle,minSamplesPerDecade,3,kernel,precision);
+            engine.reset(mt);
+            if(verbose) {
+                std::cout << "Truncation fraction is " << mt->getTruncationFraction() << std::endl;
+                std::cout << "Transform evaluated at " << mt->getNumPoints() << " points." << std::endl;
+                std::cout << "Using " << mt->getSamplesPerDecade() << " samples/decade" << std::endl;
+            }
+        }
+        std::vector<double> const& ugrid = engine->getUGrid(), vgrid = engine->getVGrid();
         if(verbose) {
-            std::cout << "Truncation fraction is " << mt.getTruncationFraction() << std::endl;
-            std::cout << "Transform evaluated at " << mt.getNumPoints() << " points." << std::endl;
             std::cout <<  "Will evaluate at " << ugrid.size() << " points covering "
-                << ugrid.back() << " to " << ugrid.front() << " ("
-                << mt.getSamplesPerDecade() << " samples/decade)" << std::endl;
+                << ugrid.back() << " to " << ugrid.front() << std::endl;
             std::cout <<  "Results estimated at " << vgrid.size() << " points covering "
                 << vgrid.front() << " to " << vgrid.back() << std::endl;
         }
@@ -99,7 +218,40 @@ int main(int argc, char **argv) {
             funcData[i] = (*PkPtr)(ugrid[i]);
         }
         std::vector<double> results(vgrid.size());
-        mt.transform(funcData,results);
+        engine->transform(funcData,results);
+        if(validateKernel && !fftlog) {
+            // Repeat the transform using the other kernel tabulation and compare results.
+            cosmo::MultipoleTransform mt2(ttype,ell,min,max,veps,strategy,
+                minSamplesPerCycle,minSamplesPerDecade,3,exactKernel ?
+                cosmo::MultipoleTransform::FastKernel : cosmo::MultipoleTransform::ExactKernel,
+                precision);
+            std::vector<double> results2(vgrid.size());
+            mt2.transform(funcData,results2);
+            double maxDiff(0), maxAbs(0);
+            for(int i = 0; i < results.size(); ++i) {
+                double diff = std::fabs(results[i] - results2[i]);
+                if(diff > maxDiff) maxDiff = diff;
+                if(std::fabs(results2[i]) > maxAbs) maxAbs = std::fabs(results2[i]);
+            }
+            std::cout << "Max difference between fast and exact kernels is " << maxDiff
+                << " (max |result| is " << maxAbs << ")" << std::endl;
+        }
+        if(comparePrecision && !fftlog) {
+            // Repeat the transform using the other precision and compare results.
+            cosmo::MultipoleTransform mt2(ttype,ell,min,max,veps,strategy,
+                minSamplesPerCycle,minSamplesPerDecade,3,kernel,singlePrecision ?
+                cosmo::MultipoleTransform::DoublePrecision : cosmo::MultipoleTransform::SinglePrecision);
+            std::vector<double> results2(vgrid.size());
+            mt2.transform(funcData,results2);
+            double maxDiff(0), maxAbs(0);
+            for(int i = 0; i < results.size(); ++i) {
+                double diff = std::fabs(results[i] - results2[i]);
+                if(diff > maxDiff) maxDiff = diff;
+                if(std::fabs(results[i]) > maxAbs) maxAbs = std::fabs(results[i]);
+            }
+            std::cout << "Max difference between single and double precision is " << maxDiff
+                << " (max |result| is " << maxAbs << ")" << std::endl;
+        }
         if(output.length() > 0) {
             std::ofstream out(output.c_str());
             for(int i = 0; i < results.size(); ++i) {